@@ -73,18 +73,6 @@ static char* jsonArrayEnd(char* outstr)
   return outstr;
 }
 
-static int calcPlugins(void)
-{
-  int pcount = 0;
-  byte *plist = pPluginFactory->pluginList();
-
-  if (plist != NULL)
-    for (int i = 0; plist[i] != 0; ++i)
-      ++pcount;
-
-  return pcount;
-}
-
 void ExecAppCmd(char* instr)
 {
   DBGOUT((F("AppCmd: \"%s\""), instr));
@@ -106,17 +94,15 @@ void ExecAppCmd(char* instr)
       char patstr[FLASHLEN_PATSTR+1];
       char patname[FLASHLEN_PATNAME+1];
 
-      int plugins = calcPlugins();
-
       pCustomCode->sendReply((char*)"?<");
       pCustomCode->sendReply((char*)"{");
 
       pCustomCode->sendReply( jsonNum(outstr, "ispaused",   !doUpdate) );
-      pCustomCode->sendReply( jsonNum(outstr, "nstrands",   STRAND_COUNT) );
+      pCustomCode->sendReply( jsonNum(outstr, "nstrands",   ENGINE_COUNT) );
       pCustomCode->sendReply( jsonNum(outstr, "maxstrlen",  MAXLEN_PATSTR) );
       pCustomCode->sendReply( jsonNum(outstr, "numlayers",  NUM_PLUGIN_LAYERS) );
       pCustomCode->sendReply( jsonNum(outstr, "numtracks",  NUM_PLUGIN_TRACKS) );
-      pCustomCode->sendReply( jsonNum(outstr, "nplugins",   plugins) );
+      pCustomCode->sendReply( jsonNum(outstr, "nplugins",   pPluginFactory->devicePlugins()) );
 
       #if DEV_PATTERNS
       pCustomCode->sendReply( jsonNum(outstr, "npatterns",  codePatterns) );
@@ -127,7 +113,7 @@ void ExecAppCmd(char* instr)
 
       int curstrand = FlashGetStrand();
 
-      for (int i = 0; i < STRAND_COUNT; ++i)
+      for (int i = 0; i < ENGINE_COUNT; ++i)
       {
         FlashSetStrand(i);
         pPixelNutEngine = &pixelNutEngines[i];
@@ -146,7 +132,7 @@ void ExecAppCmd(char* instr)
 
         FlashGetPatStr(patstr);
         jsonStr(outstr, "patstr", patstr, true);
-        if (i+1 < STRAND_COUNT) strcat(outstr, ",{");
+        if (i+1 < ENGINE_COUNT) strcat(outstr, ",{");
         pCustomCode->sendReply(outstr);
       }
       FlashSetStrand(curstrand); // restore current strand
@@ -173,18 +159,22 @@ void ExecAppCmd(char* instr)
       #if DEV_PLUGINS
       pCustomCode->sendReply( jsonArrayStart(outstr, "plugins") );
 
-      byte *plist = pPluginFactory->pluginList();
-      for (int i = 0; plist[i] != 0; ++i)
+      int plugins = pPluginFactory->devicePlugins();
+      for (int i = 0; i < plugins; ++i)
       {
-        uint16_t plugin = plist[i];
-        pCustomCode->sendReply( jsonStr(outstr, "name", pPluginFactory->pluginName(plugin)) );
-        pCustomCode->sendReply( jsonStr(outstr, "desc", pPluginFactory->pluginDesc(plugin)) );
+        PluginEntry entry;
+        pPluginFactory->deviceEntry(i, &entry);
+
+        strcpy_P(patstr, entry.name);
+        pCustomCode->sendReply( jsonStr(outstr, "name", patstr) );
+        strcpy_P(patstr, entry.desc);
+        pCustomCode->sendReply( jsonStr(outstr, "desc", patstr) );
 
-        sprintf(patname, "%04X", pPluginFactory->pluginBits(plugin));
+        sprintf(patname, "%04X", entry.bits);
         pCustomCode->sendReply( jsonStr(outstr, "bits", patname) );
 
-        jsonNum(outstr, "id", plugin, true);
-        if (plist[i+1] != 0) strcat(outstr, ",{");
+        jsonNum(outstr, "id", entry.id, true);
+        if (i+1 < plugins) strcat(outstr, ",{");
         pCustomCode->sendReply(outstr);
       }
 
@@ -224,12 +214,12 @@ void ExecAppCmd(char* instr)
     }
     case '#': // client is switching strands (goto next one if no value)
     {
-      #if (STRAND_COUNT > 1)
+      #if (ENGINE_COUNT > 1)
       byte value = *(instr+1);
       byte index;
       if (value) index = value-0x30; // convert ASCII digit to value
       else index = FlashGetStrand() + 1;
-      if (index >= STRAND_COUNT) index = 0;
+      if (index >= ENGINE_COUNT) index = 0;
 
       DBGOUT((F("Switching to strand #%d"), index));
       FlashSetStrand(index);
@@ -137,6 +137,7 @@ class RXcallbacks: public BLECharacteristicCallbacks
 
         bleEsp32.queueTail = qindex;  // release command string
         qcurstr = NULL;         // get next string in queue
+        WakeMainLoop();         // process it now if idle
         instr = pnext + 1;      // skip to next line of input
       }
     }
@@ -37,7 +37,11 @@ See license.txt for the terms of this license.
 #endif
 extern void MsgFormat(const char *fmtstr, ...);
 
+#if defined(ARDUINO)
 #include "mydevices.h" // put device specific settings here
+#else
+#include "host/mydevices.h" // settings for host builds
+#endif
 
 // template for your own settings:
 /*
@@ -45,9 +49,18 @@ extern void MsgFormat(const char *fmtstr, ...);
       #define STRAND_COUNT            1           // physically separate strands
       #define PIXEL_COUNTS            { 16 }      // pixel counts for each strand
       #define PIXEL_PINS              { 21 }      // pin selects for each strand
+      //#define PIXEL_LAYOUTS           { { 4, 4, LAYOUT_SERPENTINE, NULL } } // 2D matrix of
+                                                  // each strand: width, height, flags, XY table
+      //#define PIXEL_CLONES            { { 0, 0, 0, 8, 15, -1 } } // copies of rendered pixels: source,
+                                                  // dest strands, pixel and count, dest pixel, step
+      //#define PIXEL_RENDERS           { 8 }       // pixels rendered on each strand (0 for only clones)
+      //#define VIRTUAL_CANVAS          1           // one engine renders all strands (see below)
       #define DPIN_LED                13          // on-board R-LED for error status
 
       #define APIN_MICROPHONE         0           // pin with microphone attached
+      //#define DPIN_I2S_MIC_SCK        0           // or pins for I2S microphone (ESP32 only)
+      //#define DPIN_I2S_MIC_WS         0
+      //#define DPIN_I2S_MIC_SD         0
       #define APIN_SEED               A0          // default pin for seeding randomizer
       #define PIXELS_APA              0           // define default value
       #define SPI_SETTINGS_FREQ       4000000     // use fastest speed by default
@@ -91,6 +104,51 @@ extern void MsgFormat(const char *fmtstr, ...);
 #define DEV_PATTERNS            1           // use internal device patterns
 #endif
 
+#if !defined(ARDUINO)
+#define HOST_BUILD              1           // compiled natively (e.g. Linux) for previews/benchmarks
+#else
+#define HOST_BUILD              0
+#endif
+
+#if !defined(VIRTUAL_CANVAS)                // 1 has a single engine render a canvas of pixels that's
+#define VIRTUAL_CANVAS          0           // split into the strands by PIXEL_CLONES (from source 0),
+#endif                                      // or else the strands end to end (CANVAS_PIXELS long)
+#if VIRTUAL_CANVAS
+#define ENGINE_COUNT            1           // patterns run on the canvas, so it's the only "strand"
+#else                                       // that clients see
+#define ENGINE_COUNT            STRAND_COUNT
+#endif
+
+#if !defined(ENGINE_WORKERS)
+#define ENGINE_WORKERS          0           // >0 renders tracks in parallel with this many workers
+#endif
+#if ENGINE_WORKERS && !HOST_BUILD && !defined(ESP32)
+#error("Parallel rendering (ENGINE_WORKERS) requires ESP32 or a host build")
+#endif
+
+#if !defined(PLUGIN_DISPATCH)
+#define PLUGIN_DISPATCH         1           // 1 calls built-in plugins directly (faster, bit larger)
+#endif
+
+#if !defined(MSECS_IDLE_LOOP)
+#define MSECS_IDLE_LOOP         0           // >0 sleeps up to this long in loop() until next update
+#endif
+
+#if !defined(MAX_COMET_HEADS)               // most comets at once (one for every 8 pixels)
+#if HOST_BUILD
+#define MAX_COMET_HEADS         8191        // enough for the longest strands
+#else
+#define MAX_COMET_HEADS         12          // each head uses 9 bytes
+#endif
+#endif
+
+#if !defined(NUM_MODULATORS)
+#define NUM_MODULATORS          0           // >0 has LFOs/envelopes shared by tracks ("P" commands), max 16
+#endif
+#if !defined(MOD_TRACK_ROUTES)
+#define MOD_TRACK_ROUTES        2           // modulated properties per track, 3 bytes each
+#endif
+
 #if !defined(MSECS_WAIT_WIFI)
 #define MSECS_WAIT_WIFI         5000        // msecs to wait for original WiFi connection
 #endif
@@ -105,15 +163,42 @@ extern void MsgFormat(const char *fmtstr, ...);
 #define SPI_SETTINGS_FREQ       4000000     // use fastest speed by default
 #endif
 
+#if !defined(PIXEL_FORMAT)                  // order of color bytes sent to the pixels
+#if PIXELS_APA
+#define PIXEL_FORMAT            PixelFormat_BGR  // APA102
+#else
+#define PIXEL_FORMAT            PixelFormat_GRB  // WS2812B (PixelFormat_GRBW for SK6812 RGBW)
+#endif
+#endif
+
 #if defined(__arm__) && defined(__MK20DX256__)
 #define TEENSY_32               1
 #endif
 
-#if defined(__arm__) && defined(APIN_MICROPHONE)
-#define PLUGIN_SPECTRA          1           // uses audio input (only works on ARM processors)
+#if ((defined(__arm__) || defined(ESP32)) && defined(APIN_MICROPHONE)) || \
+    (defined(ESP32) && defined(DPIN_I2S_MIC_SD))
+#define PLUGIN_SPECTRA          1           // uses audio input (ADC on Teensy, ADC1 pin or I2S on ESP32)
 #define FREQ_FFT                1           // FFT applied to audio input
+#elif HOST_BUILD
+#define PLUGIN_SPECTRA          1           // uses audio streams (host/AudioStream)
+#define FREQ_FFT                1           // FFT applied to audio streams
 #else
 #define PLUGIN_SPECTRA          0
+#define FREQ_FFT                0
+#endif
+
+#if !defined(AUDIO_TRIGGERS)                // 1 sends external triggers ("I") on onsets (beats) of the
+#define AUDIO_TRIGGERS          0           // audio, with force from their strength (MSECS_IDLE_LOOP
+#endif                                      // should be no more than 10 for quick responses)
+#if AUDIO_TRIGGERS && !FREQ_FFT
+#error("Audio triggers (AUDIO_TRIGGERS) requires audio input")
+#endif
+
+#if !defined(FREQ_FFT_CMSIS)               // 1 uses floating point FFT from the ARM CMSIS library,
+#define FREQ_FFT_CMSIS          0           // else fixed point FFT of real samples (any processor)
+#endif
+#if FREQ_FFT_CMSIS && !defined(__arm__)
+#error("FREQ_FFT_CMSIS requires an ARM processor")
 #endif
 
 // surpress warnings for undefined symbols
@@ -50,6 +50,42 @@ static void SetupTriggerButton(void)
   // can adjust button settings here...
 }
 
+#endif
+//========================================================================================
+#if AUDIO_TRIGGERS
+
+#include "xplugins/audiobus.h"
+
+static bool audioSubscribed = false;
+static uint32_t audioOnsetFrame = 0;
+
+// triggers all strands on each onset detected in the audio (since the last check)
+static void CheckTriggerAudio(void)
+{
+  if (!audioSubscribed) return;
+
+  AudioSnapshot snap;
+  AudioBus_Update();
+  AudioBus_Read(&snap);
+
+  if (snap.onsetFrame != audioOnsetFrame)
+  {
+    audioOnsetFrame = snap.onsetFrame;
+
+    byte force = 1 + (byte)(snap.onset * (MAX_FORCE_VALUE-1));
+    DBGOUT((F("Trigger audio: force=%d tempo=%d"), force, snap.tempo));
+
+    for (int i = 0; i < ENGINE_COUNT; ++i)
+      pixelNutEngines[i].triggerForce(force);
+  }
+}
+
+static void SetupTriggerAudio(void)
+{
+  // called for each strand, but all are triggered together
+  if (!audioSubscribed) audioSubscribed = AudioBus_Subscribe();
+}
+
 #endif
 //========================================================================================
 
@@ -59,6 +95,10 @@ void SetupTriggerControls(void)
   #if defined(DPIN_TRIGGER_BUTTON)
   SetupTriggerButton();
   #endif
+
+  #if AUDIO_TRIGGERS
+  SetupTriggerAudio();
+  #endif
 }
 
 // called every control loop
@@ -67,6 +107,10 @@ void CheckTriggerControls(void)
   #if defined(DPIN_TRIGGER_BUTTON) || defined(APIN_TRIGGER_POT)
   CheckTriggerButton();
   #endif
+
+  #if AUDIO_TRIGGERS
+  CheckTriggerAudio();
+  #endif
 }
 
 //========================================================================================
@@ -6,7 +6,11 @@
 
 #pragma once
 
+#if defined(ARDUINO)
 #include <Arduino.h>
+#else
+#include "host/HostArduino.h" // native stand-in for host builds
+#endif
 
 #include "config.h" // app configuration
 #include "core/PixelNutSupport.h"
@@ -18,7 +18,7 @@ static bool GetBoolValue(char *str, bool nullval)
 }
 
 // returns -1 if no value, or not in range 0-'maxval'
-static short GetNumValue(char *str, int maxval)
+static int GetNumValue(char *str, int maxval)
 {
   if ((str == NULL) || !isdigit(*str)) return -1;
   int newval = atoi(str);
@@ -29,7 +29,7 @@ static short GetNumValue(char *str, int maxval)
 
 // clips values to range 0-'maxval' (maxval=0 for full 16 bits)
 // returns 'curval' if no value is specified
-static short GetNumValue(char *str, int curval, int maxval)
+static int GetNumValue(char *str, int curval, int maxval)
 {
   if ((str == NULL) || !isdigit(*str)) return curval;
   int newval = atoi(str);
@@ -43,6 +43,9 @@ PixelNutEngine::Status PixelNutEngine::execCmdStr(char *cmdstr)
   Status status = Status_Success;
   short curlayer = indexLayerStack;
   bool neweffects = false;
+  #if NUM_MODULATORS
+  byte curmod = 0; // modulator set by "P" commands
+  #endif
 
   for (int i = 0; cmdstr[i]; ++i) // convert to upper case
     cmdstr[i] = toupper(cmdstr[i]);
@@ -79,6 +82,67 @@ PixelNutEngine::Status PixelNutEngine::execCmdStr(char *cmdstr)
       curlayer = indexLayerStack;
       neweffects = true;
     }
+    #if NUM_MODULATORS
+    else if (cmd[0] == 'P') // modulators: "P<n>" selects one to be set or routed by the others
+    {
+      Modulator *pmod = modulators + curmod;
+
+      if (isdigit(*(cmd+1))) // there is a value after "P"
+      {
+        int index = GetNumValue(cmd+1, NUM_MODULATORS-1); // returns -1 if not in range
+        if (index >= 0) curmod = index;
+        else status = Status_Error_BadVal;
+      }
+      else switch (cmd[1])
+      {
+        case 'S': // shape of waveform ("PS" turns off the modulator)
+        {
+          pmod->shape = (byte)GetNumValue(cmd+2, ModShape_Off, ModShape_Envelope);
+          pmod->active = false;
+          pmod->phase = 0;
+          pmod->output = 0;
+          DBGOUT((F("  Modulator=%d shape=%d"), curmod, pmod->shape));
+          break;
+        }
+        case 'R': // msecs for each cycle, or for an envelope to decay ("PR" sets default value)
+        {
+          pmod->msecsPeriod = (uint16_t)GetNumValue(cmd+2, DEF_MOD_MSECS, 0);
+          if (pmod->msecsPeriod == 0) pmod->msecsPeriod = 1;
+          pmod->phaseRate = 0xFFFFFFFF / pmod->msecsPeriod;
+          break;
+        }
+        case 'T': // trigger envelope with force ("PT" uses maximum force)
+        {
+          TriggerModulator(pmod, (byte)GetNumValue(cmd+2, MAX_FORCE_VALUE, MAX_FORCE_VALUE));
+          break;
+        }
+        case 'B': // route to property of the track with the depth of modulation ("PB" removes it)
+        case 'H':
+        case 'W':
+        case 'C':
+        case 'D':
+        {
+          const char *props = "BHWCD"; // in order of ModProp_xx values
+          byte prop = (byte)(strchr(props, cmd[1]) - props);
+          int maxdepth = ((prop == ModProp_Hue) ? MAX_DVALUE_HUE : MAX_PERCENTAGE);
+          int16_t depth = (int16_t)GetNumValue(cmd+2, 0, maxdepth);
+
+          if (pdraw != NULL) status = RouteModulator(pluginLayers[curlayer].pTrack, ((curmod << 4) | prop), depth);
+          else
+          {
+            DBGOUT((F("!! Must add track before routing modulator")));
+            status = Status_Error_BadCmd;
+          }
+          break;
+        }
+        default:
+        {
+          status = Status_Error_BadCmd;
+          break;
+        }
+      }
+    }
+    #endif
     else if (pdraw != NULL)
     {
       switch (cmd[0])
@@ -94,7 +158,10 @@ PixelNutEngine::Status PixelNutEngine::execCmdStr(char *cmdstr)
           pLayer->mute = !!(value & ENABLEBIT_MUTE);
 
           if (pLayer->mute && pLayer->redraw)
+          {
             memset(TRACK_BUFFER(pLayer->pTrack), 0, pixelBytes);
+            pLayer->pTrack->pixOffset = 0;
+          }
 
           neweffects = true;
           break;
@@ -158,7 +225,7 @@ PixelNutEngine::Status PixelNutEngine::execCmdStr(char *cmdstr)
         case 'B': // percent brightness property ("B" sets default value)
         {
           pdraw->pcentBright = (byte)GetNumValue(cmd+1, DEF_PCENTBRIGHT, MAX_PERCENTAGE);
-          pixelNutSupport.makeColorVals(pdraw);
+          pixelNutSupport.colorChanged(pdraw);
           break;
         }
         case 'D': // percent drawing delay ("D" sets default value)
@@ -170,13 +237,13 @@ PixelNutEngine::Status PixelNutEngine::execCmdStr(char *cmdstr)
         case 'H': // color Hue value property ("H" sets default value)
         {
           pdraw->dvalueHue = (uint16_t)GetNumValue(cmd+1, DEF_DVALUE_HUE, MAX_DVALUE_HUE);
-          pixelNutSupport.makeColorVals(pdraw);
+          pixelNutSupport.colorChanged(pdraw);
           break;
         }
         case 'W': // percent White property ("W" sets default value)
         {
           pdraw->pcentWhite = (byte)GetNumValue(cmd+1, DEF_PCENTWHITE, MAX_PERCENTAGE);
-          pixelNutSupport.makeColorVals(pdraw);
+          pixelNutSupport.colorChanged(pdraw);
           break;
         }
         case 'C': // percent PixelCount property ("C" sets default value)
@@ -337,5 +404,7 @@ PixelNutEngine::Status PixelNutEngine::execCmdStr(char *cmdstr)
       }
     }
   }
+
+  WakeAllTracks(); // properties of any track may have been changed
   return status;
 }
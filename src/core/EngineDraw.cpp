@@ -13,59 +13,84 @@ void PixelNutEngine::setPropertyMode(bool enable)
 {
   DBGOUT((F("Engine property mode: %s"), (enable ? "enabled" : "disabled")));
   externPropMode = enable;
+  WakeAllTracks();
 }
 
 void PixelNutEngine::setColorProperty(uint16_t hue_value, byte white_percent)
 {
   externValueHue = pixelNutSupport.clipValue(hue_value, 0, MAX_DVALUE_HUE);
   externPcentWhite = pixelNutSupport.clipValue(white_percent, 0, MAX_PERCENTAGE);
+  WakeAllTracks();
 }
 
 void PixelNutEngine::setCountProperty(byte pixcount_percent)
 {
   externPcentCount = pixelNutSupport.clipValue(pixcount_percent, 0, MAX_PERCENTAGE);
+  WakeAllTracks();
 }
 
-// internal: override property values with external ones
-void PixelNutEngine::OverridePropVals(PluginTrack *pTrack)
+// internal: true if the drawing plugin and all of the active filters of a track are idle,
+// and none of its properties are being modulated
+bool PixelNutEngine::TrackIdle(PluginTrack *pTrack)
 {
-  DBGOUT((F("Override Track Properties:")));
+  #if NUM_MODULATORS
+  if (TrackModulated(pTrack)) return false; // properties keep changing
+  #endif
 
-  // map value into a pixel count (depends on the actual number of pixels)
-  uint16_t count = pixelNutSupport.mapValue(externPcentCount, 0, MAX_PERCENTAGE, 1, numPixels);
+  PluginLayer *pLayer = pTrack->pLayer;
+  for (int j = 0; j < pTrack->lcount; ++j, ++pLayer)
+    if (!pLayer->idle && ((j == 0) || (pLayer->trigActive && !pLayer->mute)))
+      return false;
+
+  return true;
+}
+
+// internal: has all plugins of a track stepped again (an idle track is already overdue)
+void PixelNutEngine::WakeTrack(PluginTrack *pTrack)
+{
+  PluginLayer *pLayer = pTrack->pLayer;
+  for (int j = 0; j < pTrack->lcount; ++j, ++pLayer)
+    pLayer->idle = false;
+}
 
-  // adjust all tracks that allow extern control with Q command
+void PixelNutEngine::WakeAllTracks(void)
+{
   for (int i = 0; i <= indexTrackStack; ++i)
-  {
-    PluginTrack *pTrack = TRACK_MAKEPTR(i);
+    WakeTrack(TRACK_MAKEPTR(i));
+}
 
-    if (pTrack->pLayer->mute) continue;
+// internal: override property values of a track with external ones
+void PixelNutEngine::OverridePropVals(PluginTrack *pTrack)
+{
+  DBGOUT((F("Track=%d Override Properties:"), TRACK_INDEX(pTrack)));
 
-    bool doset = false;
+  // map value into a pixel count (depends on the actual number of pixels)
+  uint16_t count = pixelNutSupport.mapValue(externPcentCount, 0, MAX_PERCENTAGE, 1, numPixels);
 
-    if (pTrack->ctrlBits & ExtControlBit_PixCount)
-    {
-      DBGOUT((F("  %d) cnt: %d => %d"), i, pTrack->draw.pixCount, count));
-      pTrack->draw.pixCount = count;
-    }
+  // only adjust if the track allows extern control with Q command
+  bool doset = false;
 
-    if (pTrack->ctrlBits & ExtControlBit_DegreeHue)
-    {
-      DBGOUT((F("  %d) hue: %d => %d"), i, pTrack->draw.dvalueHue, externValueHue));
-      pTrack->draw.dvalueHue = externValueHue;
-      doset = true;
-    }
+  if (pTrack->ctrlBits & ExtControlBit_PixCount)
+  {
+    DBGOUT((F("  cnt: %d => %d"), pTrack->draw.pixCount, count));
+    pTrack->draw.pixCount = count;
+  }
 
-    if (pTrack->ctrlBits & ExtControlBit_PcentWhite)
-    {
-      DBGOUT((F("  %d) wht: %d%% => %d%%"), i, pTrack->draw.pcentWhite, externPcentWhite));
-      pTrack->draw.pcentWhite = externPcentWhite;
-      doset = true;
-    }
+  if (pTrack->ctrlBits & ExtControlBit_DegreeHue)
+  {
+    DBGOUT((F("  hue: %d => %d"), pTrack->draw.dvalueHue, externValueHue));
+    pTrack->draw.dvalueHue = externValueHue;
+    doset = true;
+  }
 
-    if (doset) pixelNutSupport.makeColorVals(&pTrack->draw);
+  if (pTrack->ctrlBits & ExtControlBit_PcentWhite)
+  {
+    DBGOUT((F("  wht: %d%% => %d%%"), pTrack->draw.pcentWhite, externPcentWhite));
+    pTrack->draw.pcentWhite = externPcentWhite;
+    doset = true;
   }
 
+  if (doset) pixelNutSupport.colorChanged(&pTrack->draw);
 }
 
 // internal: restore property values to previous values
@@ -100,7 +125,215 @@ void PixelNutEngine::RestorePropVals(PluginTrack *pTrack, uint16_t pixCount, uin
     doset = true;
   }
 
-  if (doset) pixelNutSupport.makeColorVals(&pTrack->draw);
+  if (doset) pixelNutSupport.colorChanged(&pTrack->draw);
+}
+
+// internal: steps the filters then the drawing effect of a track that is due to be redrawn,
+// and sets the time of its next redraw; only touches the track and its own pixel buffer
+void PixelNutEngine::RenderTrack(PluginTrack *pTrack, DrawContext *pc)
+{
+  PluginLayer *pLayer = pTrack->pLayer;
+
+  pc->pDrawPixels = NULL; // prevent drawing by filter effects
+  pc->pTrack = pTrack;
+  RANDOM_TRACK_BEGIN(pTrack);
+
+  // call all filter effects for this track if triggered and not disabled
+  PluginLayer *pfilter = pLayer + 1;
+  for (int j = 1; j < pTrack->lcount; ++j, ++pfilter)
+    if (pfilter->trigActive && !pfilter->mute && !pfilter->idle)
+    {
+      pc->pLayer = pfilter;
+      PLUGIN_STEP(pfilter, pc, &pTrack->draw);
+    }
+
+  uint16_t pixCount = 0;
+  uint16_t dvalueHue = 0;
+  byte pcentWhite = 0;
+
+  if (externPropMode)
+  {
+    pixCount = pTrack->draw.pixCount;
+    dvalueHue = pTrack->draw.dvalueHue;
+    pcentWhite = pTrack->draw.pcentWhite;
+    OverridePropVals(pTrack);
+  }
+
+  #if NUM_MODULATORS
+  PixelNutSupport::DrawProps unmodulated = pTrack->draw;
+  ModulateTrack(pTrack);
+  #endif
+
+  // now the main drawing effect is executed for this track
+  pc->pDrawPixels = TRACK_BUFFER(pTrack); // switch to drawing buffer
+  if (pTrack->decayFactor) // fade what was drawn before in a single pass
+    pixelNutSupport.scalePixels(pc, 0, numPixels, pTrack->decayFactor);
+  pc->pLayer = pLayer;
+  pLayer->idle = false; // redrawn, so must say if still idle
+  pixelNutSupport.updateColorVals(&pTrack->draw); // once for all color changes
+  PLUGIN_STEP(pLayer, pc, &pTrack->draw);
+  pc->pDrawPixels = NULL;
+  pc->pLayer = NULL;
+
+  ScheduleRedraw(pTrack); // with the modulated delay
+
+  #if NUM_MODULATORS
+  UnmodulateTrack(pTrack, &unmodulated);
+  #endif
+
+  if (externPropMode) RestorePropVals(pTrack, pixCount, dvalueHue, pcentWhite);
+
+  RANDOM_TRACK_END(pTrack);
+}
+
+// internal: sets the time of the next redraw of a track from its delay
+void PixelNutEngine::ScheduleRedraw(PluginTrack *pTrack)
+{
+  short addmsecs = (((maxDelayMsecs * pcentDelay) / MAX_PERCENTAGE) *
+                         pTrack->draw.pcentDelay) / MAX_PERCENTAGE;
+  //DBGOUT((F("delay=%d (%d*%d*%d)"), addmsecs, maxDelayMsecs, pcentDelay, pTrack->draw.pcentDelay));
+  if (addmsecs <= 0) addmsecs = 1; // must advance at least by 1 each time
+  pTrack->msTimeRedraw = msTimeUpdate + addmsecs;
+}
+
+// internal: merges the pixels of a track's drawing window that fall within the display pixels
+// 'first' up to (not including) 'last', into the display buffer. The window starts with the
+// track pixel at 'pixStart', which is displayed at that offset from 'firstPixel' (or at the end
+// of the window if going backwards), and both wrap around the end of the strand (the track
+// pixels are read from where the buffer has been rotated to by scrolling). This is done in
+// runs of pixels within which neither wraps, so the inner loops only step the pointers.
+void PixelNutEngine::CompositeTrack(PluginTrack *pTrack, int first, int last)
+{
+  int npixels = numPixels;
+  bool backwards = pTrack->draw.goBackwards;
+
+  int count = pTrack->draw.pixLen; // number of pixels in the window
+  if ((count < 1) || (count > npixels)) count = ((count + npixels - 1) % npixels) + 1;
+
+  int dpix = firstPixel + pTrack->draw.pixStart; // display pixel for start of the next run
+  if (dpix >= npixels) dpix -= npixels;
+  if (backwards)
+  {
+    dpix += count - 1;
+    if (dpix >= npixels) dpix -= npixels;
+  }
+
+  int tpix = pTrack->draw.pixStart + pTrack->pixOffset; // where that track pixel is stored
+  if (tpix >= npixels) tpix -= npixels;
+
+  byte *ptrack = TRACK_BUFFER(pTrack);
+
+  while (count > 0)
+  {
+    // length of this run: up to where either pixel wraps around
+    int run = npixels - tpix;
+    int drun = (backwards ? (dpix + 1) : (npixels - dpix));
+    if (run > drun) run = drun;
+    if (run > count) run = count;
+
+    // lowest display pixel in the run, and the part of it that's within the block
+    int dlow = (backwards ? (dpix - run + 1) : dpix);
+    int dstart = (dlow > first) ? dlow : first;
+    int dend = ((dlow + run) < last) ? (dlow + run) : last;
+
+    if (dstart < dend)
+    {
+      byte *pdisp = pDisplayPixels + (dstart * PIXEL_BYTES);
+      byte *pend = pDisplayPixels + (dend * PIXEL_BYTES);
+      int tstep = (backwards ? -PIXEL_BYTES : PIXEL_BYTES);
+      byte *psrc = ptrack + ((backwards ? (tpix + (dpix - dstart)) :
+                                          (tpix + (dstart - dpix))) * PIXEL_BYTES);
+
+      if (pTrack->draw.pixOrValues)
+      {
+        // combine contents of buffer window with actual pixel array
+        for (; pdisp < pend; pdisp += PIXEL_BYTES, psrc += tstep)
+          for (int k = 0; k < PIXEL_BYTES; ++k) pdisp[k] |= psrc[k];
+      }
+      else
+      {
+        for (; pdisp < pend; pdisp += PIXEL_BYTES, psrc += tstep)
+        {
+          byte nonzero = 0;
+          for (int k = 0; k < PIXEL_BYTES; ++k) nonzero |= psrc[k];
+          if (nonzero) memcpy(pdisp, psrc, PIXEL_BYTES);
+        }
+      }
+    }
+
+    count -= run;
+    tpix += run;
+    if (tpix >= npixels) tpix = 0;
+
+    if (backwards)
+    {
+      dpix -= run;
+      if (dpix < 0) dpix = npixels - 1;
+    }
+    else
+    {
+      dpix += run;
+      if (dpix >= npixels) dpix = 0;
+    }
+  }
+}
+
+void PixelNutEngine::cloneOutput(const PixelClone *pclone, byte *pdest, uint16_t dest_pixels)
+{
+  if (pclone->srcPos >= numPixels) return;
+
+  int count = pclone->count;
+  if ((pclone->srcPos + count) > numPixels) count = numPixels - pclone->srcPos;
+
+  byte *psrc = pDisplayPixels + (pclone->srcPos * PIXEL_BYTES);
+  int dpix = pclone->destPos;
+  int step = pclone->destStep ? pclone->destStep : 1;
+
+  if (step == 1) // in a single copy
+  {
+    if (dpix >= dest_pixels) return;
+    if ((dpix + count) > dest_pixels) count = dest_pixels - dpix;
+    memcpy((pdest + (dpix * PIXEL_BYTES)), psrc, (count * PIXEL_BYTES));
+    return;
+  }
+
+  for (; (count > 0) && (dpix >= 0) && (dpix < dest_pixels); --count, dpix += step, psrc += PIXEL_BYTES)
+    memcpy((pdest + (dpix * PIXEL_BYTES)), psrc, PIXEL_BYTES);
+}
+
+uint32_t PixelNutEngine::msecsUntilDue(void)
+{
+  if (msTimeUpdate == 0) return 0; // first update always shows
+
+  uint32_t time = pixelNutSupport.getMsecs();
+  if (msTimeUpdate > time) return 0; // rolled over: let updateEffects() reset the times
+
+  uint32_t due = ENGINE_NEVER_DUE;
+
+  for (int i = 0; i <= indexTrackStack; ++i)
+  {
+    PluginTrack *pTrack = TRACK_MAKEPTR(i);
+    PluginLayer *pLayer = pTrack->pLayer;
+
+    if (!pLayer->trigActive || pLayer->mute || TrackIdle(pTrack)) continue; // not redrawn
+
+    if (pTrack->msTimeRedraw <= time) return 0;
+    if ((pTrack->msTimeRedraw - time) < due) due = pTrack->msTimeRedraw - time;
+  }
+
+  for (int i = 0; i <= indexLayerStack; ++i) // same test as RepeatTriger()
+  {
+    PluginLayer *pLayer = pluginLayers + i;
+    if (!pLayer->mute &&
+        (pLayer->trigType & TrigTypeBit_Repeating) &&
+        (pLayer->trigDnCounter || !pLayer->trigRepCount))
+    {
+      if (pLayer->trigTimeMsecs <= time) return 0;
+      if ((pLayer->trigTimeMsecs - time) < due) due = pLayer->trigTimeMsecs - time;
+    }
+  }
+
+  return due;
 }
 
 bool PixelNutEngine::updateEffects(void)
@@ -109,12 +342,21 @@ bool PixelNutEngine::updateEffects(void)
 
   uint32_t time = pixelNutSupport.getMsecs();
   bool rollover = (msTimeUpdate > time);
+
+  #if NUM_MODULATORS
+  UpdateModulators((doshow || rollover) ? 0 : (time - msTimeUpdate));
+  #endif
+
   msTimeUpdate = time;
 
   RepeatTriger(); //check if need to generate a trigger
 
   // first have any redraw effects that are ready draw into its own buffers...
 
+  #if ENGINE_WORKERS
+  countDueTracks = 0;
+  #endif
+
   for (int i = 0; i <= indexTrackStack; ++i) // for each plugin that can redraw
   {
     PluginTrack *pTrack = TRACK_MAKEPTR(i);
@@ -134,129 +376,48 @@ bool PixelNutEngine::updateEffects(void)
     // update the time if it's rolled over, then check if time to draw
     if (rollover) pTrack->msTimeRedraw = msTimeUpdate;
     if (pTrack->msTimeRedraw > msTimeUpdate) continue;
-
-    pDrawPixels = NULL; // prevent drawing by filter effects
-
-    // call all filter effects for this track if triggered and not disabled
-    PluginLayer *pfilter = pLayer + 1;
-    for (int j = 1; j < pTrack->lcount; ++j, ++pfilter)
-      if (pfilter->trigActive && !pfilter->mute)
-        pfilter->pPlugin->nextstep(this, &pTrack->draw);
-
-    short pixCount = 0;
-    uint16_t dvalueHue = 0;
-    byte pcentWhite = 0;
-
-    if (externPropMode)
+    if (TrackIdle(pTrack)) // parked until woken, but keeps to its schedule
     {
-      pixCount = pTrack->draw.pixCount;
-      dvalueHue = pTrack->draw.dvalueHue;
-      pcentWhite = pTrack->draw.pcentWhite;
-      OverridePropVals(pTrack);
+      ScheduleRedraw(pTrack);
+      continue;
     }
 
-    // now the main drawing effect is executed for this track
-    pDrawPixels = TRACK_BUFFER(pTrack); // switch to drawing buffer
-    pLayer->pPlugin->nextstep(this, &pTrack->draw);
-    pDrawPixels = pDisplayPixels; // restore to draw from display buffer
-
-    if (externPropMode) RestorePropVals(pTrack, pixCount, dvalueHue, pcentWhite);
-
-    short addmsecs = (((maxDelayMsecs * pcentDelay) / MAX_PERCENTAGE) *
-                           pTrack->draw.pcentDelay) / MAX_PERCENTAGE;
-    //DBGOUT((F("delay=%d (%d*%d*%d)"), addmsecs, maxDelayMsecs, pcentDelay, pTrack->draw.pcentDelay));
-    if (addmsecs <= 0) addmsecs = 1; // must advance at least by 1 each time
-    pTrack->msTimeRedraw = msTimeUpdate + addmsecs;
+    #if ENGINE_WORKERS
+    pDueTracks[countDueTracks++] = pTrack; // rendered all together below
+    #else
+    RenderTrack(pTrack, &drawContext);
+    #endif
 
     doshow = true;
   }
 
+  #if ENGINE_WORKERS
+  if (countDueTracks > 0) RenderParallel();
+  #endif
+
   if (doshow)
   {
-    // merge all buffers whether just redrawn or not if anyone of them changed
-    memset(pDisplayPixels, 0, pixelBytes); // must clear display buffer first
-
-    for (int i = 0; i <= indexTrackStack; ++i) // for each plugin that can redraw
+    // merge all buffers whether just redrawn or not if anyone of them changed,
+    // a block of the display at a time so it stays in the cache while merging
+    for (int first = 0; first < numPixels; first += COMPOSITE_PIXELS)
     {
-      PluginTrack *pTrack = TRACK_MAKEPTR(i);
-      PluginLayer *pLayer = pTrack->pLayer;
-
-      // don't show if layer is muted or not triggered yet,
-      // but do draw if just not updated from above
-      if (pLayer->mute || !pLayer->trigActive)
-        continue;
-
-      short pixlast = numPixels-1;
-      short pixstart = firstPixel + pTrack->draw.pixStart;
-      //DBGOUT((F("%d PixStart: %d == %d+%d"), pTrack->draw.goBackwards, pixstart, firstPixel, pTrack->draw.pixStart));
-      if (pixstart > pixlast) pixstart -= (pixlast+1);
-
-      short pixend = pixstart + pTrack->draw.pixLen - 1;
-      //DBGOUT((F("%d PixEnd:  %d == %d+%d-1"), pTrack->draw.goBackwards, pixend, pixstart, pTrack->draw.pixLen));
-      if (pixend > pixlast) pixend -= (pixlast+1);
-
-      short pix = (pTrack->draw.goBackwards ? pixend : pixstart);
-      short x = pix * numBytesPerPixel;
-      short y = pTrack->draw.pixStart * numBytesPerPixel;
-
-      byte *ppix = TRACK_BUFFER(pTrack);
-      /*
-      DBGOUT((F("Input pixels:")));
-      for (int i = 0; i < numPixels; ++i)
-        DBGOUT((F("  %d.%d.%d"), *p++, *p++, *p++));
-      */
-      while(true)
-      {
-        //DBGOUT((F(">> start.end=%d.%d pix=%d x=%d y=%d"), pixstart, pixend, pix, x, y));
+      int last = first + COMPOSITE_PIXELS;
+      if (last > numPixels) last = numPixels;
 
-        if (pTrack->draw.pixOrValues)
-        {
-          // combine contents of buffer window with actual pixel array
-          pDisplayPixels[x+0] |= ppix[y+0];
-          pDisplayPixels[x+1] |= ppix[y+1];
-          pDisplayPixels[x+2] |= ppix[y+2];
-        }
-        else if ((ppix[y+0] != 0) ||
-                 (ppix[y+1] != 0) ||
-                 (ppix[y+2] != 0))
-        {
-          pDisplayPixels[x+0] = ppix[y+0];
-          pDisplayPixels[x+1] = ppix[y+1];
-          pDisplayPixels[x+2] = ppix[y+2];
-        }
+      // must clear display buffer first
+      memset(pDisplayPixels + (first * PIXEL_BYTES), 0, (last - first) * PIXEL_BYTES);
 
-        if (!pTrack->draw.goBackwards)
-        {
-          if (pix == pixend) break;
-
-          if (pix >= pixlast) // wrap around to start of strip
-          {
-            pix = x = 0;
-          }
-          else
-          {
-            ++pix;
-            x += 3;
-          }
-        }
-        else // going backwards
-        {
-          if (pix == pixstart) break;
-  
-          if (pix <= 0) // wrap around to end of strip
-          {
-            pix = pixlast;
-            x = (pixlast * numBytesPerPixel);
-          }
-          else
-          {
-            --pix;
-            x -= 3;
-          }
-        }
+      for (int i = 0; i <= indexTrackStack; ++i) // for each plugin that can redraw
+      {
+        PluginTrack *pTrack = TRACK_MAKEPTR(i);
+        PluginLayer *pLayer = pTrack->pLayer;
+
+        // don't show if layer is muted or not triggered yet,
+        // but do draw if just not updated from above
+        if (pLayer->mute || !pLayer->trigActive)
+          continue;
 
-        if (y >= (pixlast * numBytesPerPixel)) y = 0;
-        else y += 3;
+        CompositeTrack(pTrack, first, last);
       }
     }
 
@@ -0,0 +1,123 @@
+// PixelNut Engine Class Implementation of 2D Layouts
+/*
+    Copyright (c) 2021, Greg de Valois
+    Software License Agreement (MIT License)
+    See license.txt for the terms of this license.
+*/
+// Matrices are wired in many ways (rows or columns, serpentine or not, or arbitrarily by a
+// table), which is worked out here once: plugins then find the pixel at any x,y with a single
+// lookup, and draw whole rows as spans of pixels, so they needn't know how it's wired.
+
+#define DEBUG_OUTPUT 0 // 1 enables debugging this file
+
+#include "core.h"
+
+// internal: returns pixel at x,y of a layout, or LAYOUT_NO_PIXEL if none
+uint16_t PixelNutEngine::LayoutPixel(const PixelLayout *layout, uint16_t x, uint16_t y)
+{
+  uint32_t index;
+
+  if (layout->flags & LAYOUT_TABLE)
+    index = pgm_read_word(&layout->ptable[(y * layout->width) + x]);
+
+  else if (layout->flags & LAYOUT_COLUMNS)
+  {
+    if ((layout->flags & LAYOUT_SERPENTINE) && (x & 1)) y = layout->height - 1 - y;
+    index = ((uint32_t)x * layout->height) + y;
+  }
+  else
+  {
+    if ((layout->flags & LAYOUT_SERPENTINE) && (y & 1)) x = layout->width - 1 - x;
+    index = ((uint32_t)y * layout->width) + x;
+  }
+
+  return (index < numPixels) ? index : LAYOUT_NO_PIXEL;
+}
+
+// internal: finds the spans of pixels that make up row 'y', storing them if 'pspans' isn't NULL,
+// and returns how many there are: a span continues while each pixel is the same step from the
+// one before it (so any two pixels can start a span)
+int PixelNutEngine::LayoutRowSpans(uint16_t y, PixelNutSupport::LayoutSpan *pspans)
+{
+  uint16_t *pindex = pLayoutIndexes + (y * layoutWidth);
+  PixelNutSupport::LayoutSpan span;
+  span.count = 0;
+  int count = 0;
+
+  for (int x = 0; x <= layoutWidth; ++x)
+  {
+    uint16_t pos = (x < layoutWidth) ? pindex[x] : LAYOUT_NO_PIXEL;
+
+    if (span.count > 0)
+    {
+      int step = (int)pos - (int)pindex[x-1];
+      if ((pos != LAYOUT_NO_PIXEL) && ((span.count == 1) || (step == span.step)))
+      {
+        span.step = step;
+        ++span.count;
+        continue;
+      }
+
+      if (pspans != NULL) pspans[count] = span;
+      ++count;
+    }
+
+    span.x = x;
+    span.pos = pos;
+    span.count = (pos != LAYOUT_NO_PIXEL) ? 1 : 0;
+    span.step = 1;
+  }
+
+  return count;
+}
+
+// internal: builds the pixel index and row span tables from a layout (or a single row if NULL)
+bool PixelNutEngine::InitLayout(const PixelLayout *layout)
+{
+  pLayoutIndexes = NULL;
+  pLayoutSpans = NULL;
+  pLayoutRows = NULL;
+
+  lineSpan.x = 0;
+  lineSpan.pos = 0;
+  lineSpan.count = numPixels;
+  lineSpan.step = 1;
+
+  if ((layout == NULL) || (layout->width == 0) || (layout->height == 0) ||
+      ((layout->flags & LAYOUT_TABLE) && (layout->ptable == NULL)))
+  {
+    layoutWidth = numPixels;
+    layoutHeight = 1;
+    return (layout == NULL);
+  }
+
+  layoutWidth = layout->width;
+  layoutHeight = layout->height;
+  uint32_t cells = (uint32_t)layoutWidth * layoutHeight;
+
+  pLayoutIndexes = (uint16_t*)malloc(cells * sizeof(uint16_t));
+  pLayoutRows = (uint16_t*)malloc((layoutHeight + 1) * sizeof(uint16_t));
+  if ((pLayoutIndexes == NULL) || (pLayoutRows == NULL)) return false;
+
+  uint16_t *pindex = pLayoutIndexes;
+  for (int y = 0; y < layoutHeight; ++y)
+    for (int x = 0; x < layoutWidth; ++x)
+      *pindex++ = LayoutPixel(layout, x, y);
+
+  int count = 0;
+  for (int y = 0; y < layoutHeight; ++y)
+  {
+    pLayoutRows[y] = count;
+    count += LayoutRowSpans(y, NULL);
+  }
+  pLayoutRows[layoutHeight] = count;
+
+  pLayoutSpans = (PixelNutSupport::LayoutSpan*)malloc((count ? count : 1) * sizeof(PixelNutSupport::LayoutSpan));
+  if (pLayoutSpans == NULL) return false;
+
+  for (int y = 0; y < layoutHeight; ++y)
+    LayoutRowSpans(y, pLayoutSpans + pLayoutRows[y]);
+
+  DBGOUT((F("Layout: %dx%d flags=%d spans=%d"), layoutWidth, layoutHeight, layout->flags, count));
+  return true;
+}
@@ -11,9 +11,11 @@
 
 bool PixelNutEngine::init(uint16_t num_pixels, byte num_bytes,
                           byte num_layers, byte num_tracks,
-                          uint16_t first_pixel, bool backwards)
+                          uint16_t first_pixel, bool backwards,
+                          const PixelLayout *layout)
 {
-  pixelBytes = num_pixels * num_bytes;
+  if (num_bytes != PIXEL_BYTES) return false; // must match the format for the build
+  pixelBytes = num_pixels * PIXEL_BYTES;
 
   // allocate track and layer stacks; add 1 for use in swapping
   // track includes pixel buffer after end of structure
@@ -29,7 +31,6 @@ bool PixelNutEngine::init(uint16_t num_pixels, byte num_bytes,
   // customize engine settings:
 
   numPixels         = num_pixels;
-  numBytesPerPixel  = num_bytes;
   firstPixel        = first_pixel;
   goBackwards       = backwards;
 
@@ -37,6 +38,24 @@ bool PixelNutEngine::init(uint16_t num_pixels, byte num_bytes,
   maxPluginTracks = (short)num_tracks; // swap track at this index
 
   pDrawPixels = pDisplayPixels;
+
+  if (!InitLayout(layout)) return false;
+
+  #if HOST_BUILD
+  randSeed = (uint32_t)random(1, 0x7FFFFFFF); // engines differ from each other
+  #endif
+
+  drawContext.pEngine = this;
+  drawContext.pDrawPixels = NULL;
+  drawContext.pTrack = NULL;
+  drawContext.pLayer = NULL;
+  #if NUM_MODULATORS
+  ClearModulators();
+  #endif
+  #if ENGINE_WORKERS
+  if (!InitWorkers()) return false;
+  #endif
+
   return true;
 }
 
@@ -47,11 +66,15 @@ void PixelNutEngine::TriggerLayer(PluginLayer *pLayer, byte force)
 
   DBGOUT((F("Trigger: track=%d layer=%d force=%d"), TRACK_INDEX(pTrack), LAYER_INDEX(pLayer), force));
 
-  byte *dptr = pDrawPixels;
-  // prevent drawing if filter effect
-  pDrawPixels = (pLayer->redraw ? TRACK_BUFFER(pTrack) : NULL);
-  pLayer->pPlugin->trigger(this, &pTrack->draw, force);
-  pDrawPixels = dptr; // restore to the previous value
+  DrawContext context; // prevent drawing if filter effect
+  context.pEngine = this;
+  context.pDrawPixels = (pLayer->redraw ? TRACK_BUFFER(pTrack) : NULL);
+  context.pTrack = pTrack;
+  context.pLayer = NULL; // forces sent from here are not deferred
+  RANDOM_TRACK_BEGIN(pTrack);
+  PLUGIN_TRIGGER(pLayer, &context, &pTrack->draw, force);
+  RANDOM_TRACK_END(pTrack);
+  WakeTrack(pTrack); // properties may have changed
 
   // if this is the drawing effect for the track then redraw immediately
   if (pLayer->redraw) pTrack->msTimeRedraw = pixelNutSupport.getMsecs();
@@ -74,6 +97,8 @@ void PixelNutEngine::RepeatTriger(void)
                 pluginLayers[i].trigRepCount, pluginLayers[i].trigDnCounter,
                 pluginLayers[i].trigRepOffset, pluginLayers[i].trigRepRange));
 
+      RANDOM_TRACK_BEGIN(pluginLayers[i].pTrack);
+
       byte force = (pluginLayers[i].randForce) ?
                       random(0, MAX_FORCE_VALUE+1) :
                       pluginLayers[i].trigForce;
@@ -86,6 +111,8 @@ void PixelNutEngine::RepeatTriger(void)
                          pluginLayers[i].trigRepRange+1)));
 
       if (pluginLayers[i].trigDnCounter > 0) --pluginLayers[i].trigDnCounter;
+
+      RANDOM_TRACK_END(pluginLayers[i].pTrack);
     }
   }
 }
@@ -93,6 +120,11 @@ void PixelNutEngine::RepeatTriger(void)
 // external: called from client command
 void PixelNutEngine::triggerForce(byte force)
 {
+  #if NUM_MODULATORS
+  for (int i = 0; i < NUM_MODULATORS; ++i)
+    TriggerModulator(modulators + i, force);
+  #endif
+
   for (int i = 0; i <= indexLayerStack; ++i)
     if (!pluginLayers[i].mute &&
         (pluginLayers[i].trigType & TrigTypeBit_External))
@@ -108,3 +140,17 @@ void PixelNutEngine::triggerForce(uint16_t id, byte force)
         (pluginLayers[i].trigLayerID == id))
       TriggerLayer((pluginLayers + i), force);
 }
+
+// internal: called through the support routines when a plugin sends a force
+void PixelNutEngine::SendForce(DrawContext *pc, uint16_t id, byte force)
+{
+  #if ENGINE_WORKERS
+  if (pc->pLayer != NULL) // tracks are being rendered: trigger after all are done
+  {
+    QueueForce(pc, id, force);
+    return;
+  }
+  #endif
+
+  triggerForce(id, force);
+}
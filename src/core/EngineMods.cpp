@@ -0,0 +1,260 @@
+// PixelNut Engine Class Implementation of Modulators
+/*
+    Copyright (c) 2021, Greg de Valois
+    Software License Agreement (MIT License)
+    See license.txt for the terms of this license.
+*/
+// Modulators take the place of filter plugins such as CountWave or BrightSurge, which each
+// need a layer (and a plugin object) for every track they modulate and calculate in floating
+// point on every step. A modulator is calculated in fixed point once per update, however many
+// tracks it's routed to, and a route costs each track only a few bytes and an add while drawing.
+
+#define DEBUG_OUTPUT 0 // 1 enables debugging this file
+
+#include "core.h"
+
+#if NUM_MODULATORS
+
+#define MOD_INDEX(m)        ((m) >> 4)      // parts of the 'modprop' value of a route
+#define MOD_PROP(m)         ((m) & 0x0F)
+
+// returns sine of a phase (2^32 is a full circle) from a parabola, which is then corrected
+// to within 0.1% of the true value: y = x(1-|x|) for x of -1...1 over the circle, then
+// y += 0.225 * (y|y| - y), all in Q15 fixed point
+static int16_t ModSine(uint32_t phase)
+{
+  int32_t x = (int16_t)(phase >> 16);
+  int32_t y = (x * (32768 - ((x < 0) ? -x : x))) >> 13;
+  y += ((((y * ((y < 0) ? -y : y)) >> 15) - y) * 7373) >> 15;
+
+  if (y >  MOD_OUTPUT_ONE) return  MOD_OUTPUT_ONE;
+  if (y < -MOD_OUTPUT_ONE) return -MOD_OUTPUT_ONE;
+  return y;
+}
+
+// returns triangle wave of a phase, in step with the sine wave: rising from 0
+static int16_t ModTriangle(uint32_t phase)
+{
+  int32_t x = (uint16_t)((phase >> 16) + 0x4000); // 0 at the minimum
+  int32_t y = (x < 0x8000) ? ((x * 2) - 0x8000) : (0x17FFF - (x * 2));
+  if (y < -MOD_OUTPUT_ONE) return -MOD_OUTPUT_ONE;
+  return y;
+}
+
+void PixelNutEngine::ClearModulators(void)
+{
+  memset(modulators, 0, sizeof(modulators));
+
+  for (int i = 0; i < NUM_MODULATORS; ++i)
+  {
+    modulators[i].msecsPeriod = DEF_MOD_MSECS;
+    modulators[i].phaseRate = 0xFFFFFFFF / DEF_MOD_MSECS;
+  }
+}
+
+// internal: advances all of the modulators by the msecs since the previous update
+void PixelNutEngine::UpdateModulators(uint32_t msecs)
+{
+  Modulator *pmod = modulators;
+  for (int i = 0; i < NUM_MODULATORS; ++i, ++pmod)
+  {
+    uint32_t step = pmod->phaseRate * msecs; // wraps around for more than a full cycle
+
+    switch (pmod->shape)
+    {
+      case ModShape_Off: break;
+
+      case ModShape_Sine:
+      {
+        pmod->phase += step;
+        pmod->output = ModSine(pmod->phase);
+        break;
+      }
+      case ModShape_Triangle:
+      {
+        pmod->phase += step;
+        pmod->output = ModTriangle(pmod->phase);
+        break;
+      }
+      case ModShape_Square:
+      {
+        pmod->phase += step;
+        pmod->output = (pmod->phase < 0x80000000) ? MOD_OUTPUT_ONE : -MOD_OUTPUT_ONE;
+        break;
+      }
+      case ModShape_Sawtooth:
+      {
+        pmod->phase += step;
+        pmod->output = (int32_t)(pmod->phase >> 16) - 0x8000;
+        if (pmod->output < -MOD_OUTPUT_ONE) pmod->output = -MOD_OUTPUT_ONE;
+        break;
+      }
+      case ModShape_Envelope:
+      {
+        if (!pmod->active) break;
+
+        if ((msecs >= pmod->msecsPeriod) || ((pmod->phase + step) < pmod->phase))
+        {
+          pmod->active = false;
+          pmod->output = 0;
+
+          // tracks that were modulated must be drawn once more without it
+          for (int j = 0; j <= indexTrackStack; ++j)
+          {
+            PluginTrack *pTrack = TRACK_MAKEPTR(j);
+            for (int k = 0; k < MOD_TRACK_ROUTES; ++k)
+              if (pTrack->modRoutes[k].depth && (MOD_INDEX(pTrack->modRoutes[k].modprop) == i))
+                WakeTrack(pTrack);
+          }
+        }
+        else
+        {
+          pmod->phase += step;
+          pmod->output = ((int32_t)pmod->peak * (uint16_t)(~pmod->phase >> 16)) >> 16;
+        }
+        break;
+      }
+    }
+  }
+}
+
+// internal: starts an envelope at the level of the force ("PT" command or external triggers)
+void PixelNutEngine::TriggerModulator(Modulator *pmod, byte force)
+{
+  if (pmod->shape != ModShape_Envelope) return;
+
+  pmod->peak = ((int32_t)force * MOD_OUTPUT_ONE) / MAX_FORCE_VALUE;
+  pmod->output = pmod->peak;
+  pmod->phase = 0;
+  pmod->active = true;
+
+  DBGOUT((F("Modulator=%d triggered: force=%d"), (pmod - modulators), force));
+}
+
+// internal: routes modulator to a property of a track, replacing any previous route for that
+// property, or removes that route if 'depth' is 0; fails if the track has no routes left
+PixelNutEngine::Status PixelNutEngine::RouteModulator(PluginTrack *pTrack, byte modprop, int16_t depth)
+{
+  ModRoute *pfree = NULL;
+
+  for (int i = 0; i < MOD_TRACK_ROUTES; ++i)
+  {
+    ModRoute *proute = pTrack->modRoutes + i;
+
+    if (proute->depth && (MOD_PROP(proute->modprop) == MOD_PROP(modprop)))
+    {
+      pfree = proute;
+      break;
+    }
+    if (!proute->depth && (pfree == NULL)) pfree = proute;
+  }
+
+  DBGOUT((F("Track=%d route modulator=%d prop=%d depth=%d"), TRACK_INDEX(pTrack),
+          MOD_INDEX(modprop), MOD_PROP(modprop), depth));
+
+  if (pfree == NULL) return (depth ? Status_Error_Memory : Status_Success);
+
+  pfree->modprop = modprop;
+  pfree->depth = depth;
+  return Status_Success;
+}
+
+// internal: true if track has a route from a modulator that's running
+bool PixelNutEngine::TrackModulated(PluginTrack *pTrack)
+{
+  for (int i = 0; i < MOD_TRACK_ROUTES; ++i)
+  {
+    ModRoute *proute = pTrack->modRoutes + i;
+    if (!proute->depth) continue;
+
+    Modulator *pmod = modulators + MOD_INDEX(proute->modprop);
+    if ((pmod->shape != ModShape_Off) && ((pmod->shape != ModShape_Envelope) || pmod->active))
+      return true;
+  }
+
+  return false;
+}
+
+// internal: adds the outputs of the modulators to the properties routed to them
+void PixelNutEngine::ModulateTrack(PluginTrack *pTrack)
+{
+  PixelNutSupport::DrawProps *pdraw = &pTrack->draw;
+  bool docolor = false;
+
+  for (int i = 0; i < MOD_TRACK_ROUTES; ++i)
+  {
+    ModRoute *proute = pTrack->modRoutes + i;
+    if (!proute->depth) continue;
+
+    int32_t output = modulators[MOD_INDEX(proute->modprop)].output;
+    int32_t change = (output * proute->depth) / MOD_OUTPUT_ONE;
+    int32_t value;
+
+    switch (MOD_PROP(proute->modprop))
+    {
+      case ModProp_Bright:
+      {
+        value = pdraw->pcentBright + change;
+        pdraw->pcentBright = pixelNutSupport.clipValue(value, 0, MAX_PERCENTAGE);
+        docolor = true;
+        break;
+      }
+      case ModProp_Hue: // wraps around the color wheel
+      {
+        value = (pdraw->dvalueHue + change) % (MAX_DVALUE_HUE+1);
+        if (value < 0) value += (MAX_DVALUE_HUE+1);
+        pdraw->dvalueHue = value;
+        docolor = true;
+        break;
+      }
+      case ModProp_White:
+      {
+        value = pdraw->pcentWhite + change;
+        pdraw->pcentWhite = pixelNutSupport.clipValue(value, 0, MAX_PERCENTAGE);
+        docolor = true;
+        break;
+      }
+      case ModProp_Count:
+      {
+        change = ((int32_t)proute->depth * numPixels) / MAX_PERCENTAGE; // in pixels
+        value = pdraw->pixCount + ((output * change) / MOD_OUTPUT_ONE);
+        pdraw->pixCount = pixelNutSupport.clipValue(value, 1, numPixels);
+        break;
+      }
+      case ModProp_Delay:
+      {
+        value = pdraw->pcentDelay + change;
+        pdraw->pcentDelay = pixelNutSupport.clipValue(value, 0, MAX_PERCENTAGE);
+        break;
+      }
+    }
+  }
+
+  if (docolor) pixelNutSupport.colorChanged(pdraw);
+}
+
+// internal: restores the modulated properties of a track to what they were before, leaving
+// any other changes made while drawing (by a trigger from a force the track sent)
+void PixelNutEngine::UnmodulateTrack(PluginTrack *pTrack, PixelNutSupport::DrawProps *pdraw)
+{
+  bool docolor = false;
+
+  for (int i = 0; i < MOD_TRACK_ROUTES; ++i)
+  {
+    ModRoute *proute = pTrack->modRoutes + i;
+    if (!proute->depth) continue;
+
+    switch (MOD_PROP(proute->modprop))
+    {
+      case ModProp_Bright: pTrack->draw.pcentBright = pdraw->pcentBright; docolor = true; break;
+      case ModProp_Hue:    pTrack->draw.dvalueHue   = pdraw->dvalueHue;   docolor = true; break;
+      case ModProp_White:  pTrack->draw.pcentWhite  = pdraw->pcentWhite;  docolor = true; break;
+      case ModProp_Count:  pTrack->draw.pixCount    = pdraw->pixCount;    break;
+      case ModProp_Delay:  pTrack->draw.pcentDelay  = pdraw->pcentDelay;  break;
+    }
+  }
+
+  if (docolor) pixelNutSupport.colorChanged(&pTrack->draw);
+}
+
+#endif // NUM_MODULATORS
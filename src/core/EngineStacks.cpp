@@ -21,6 +21,10 @@ void PixelNutEngine::clearStacks(void)
   indexLayerStack = -1;
   indexTrackStack = -1;
 
+  #if NUM_MODULATORS
+  ClearModulators();
+  #endif
+
   // clear all pixels and force redisplay
   memset(pDisplayPixels, 0, pixelBytes);
   msTimeUpdate = 0;
@@ -123,6 +127,8 @@ PixelNutEngine::Status PixelNutEngine::MakeNewPlugin(uint16_t iplugin, PixelNutP
     return Status_Error_BadCmd;
   }
 
+  DBGOUT((F("New plugin: #%d size=%d"), iplugin, pPluginFactory->pluginSize(iplugin)));
+
   *ppPlugin = pPluginFactory->pluginCreate(iplugin);
   if (*ppPlugin == NULL) return Status_Error_BadVal;
 
@@ -151,7 +157,7 @@ void PixelNutEngine::InitPluginTrack(PluginTrack *pTrack, PluginLayer *pLayer)
   SETVAL_IF_NONZERO(pProps->pixOrValues, DEF_PIXORVALS);
   SETVAL_IF_NONZERO(pProps->noRepeating, DEF_NOREPEATING);
 
-  pixelNutSupport.makeColorVals(pProps); // create RGB values
+  pixelNutSupport.colorChanged(pProps); // RGB values created before first drawn
 }
 
 void PixelNutEngine::InitPluginLayer(PluginLayer *pLayer, PluginTrack *pTrack,
@@ -165,6 +171,14 @@ void PixelNutEngine::InitPluginLayer(PluginLayer *pLayer, PluginTrack *pTrack,
   pLayer->redraw  = redraw;
   pLayer->pTrack  = pTrack;
 
+  #if HOST_BUILD
+  if (redraw) // track's sequence comes from its engine and drawing layer, not the thread
+  {
+    pTrack->randState = randSeed ^ (pLayer->thisLayerID * 0x9E3779B9);
+    if (pTrack->randState == 0) pTrack->randState = 1;
+  }
+  #endif
+
   SETVAL_IF_NONZERO(pLayer->trigForce,     DEF_FORCEVAL);
   SETVAL_IF_NONZERO(pLayer->trigRepCount,  DEF_TRIG_FOREVER);
   SETVAL_IF_NONZERO(pLayer->trigRepOffset, DEF_TRIG_OFFSET);
@@ -335,9 +349,15 @@ PixelNutEngine::Status PixelNutEngine::SwitchPluginLayer(short layer, uint16_t i
   pLayer->pPlugin = pPlugin;
   pLayer->iplugin = iplugin;
   pLayer->trigActive = false;
+  pLayer->idle = false;
 
   // clear pixel buffer if this is a redraw layer
-  if (redraw) memset(TRACK_BUFFER(pLayer->pTrack), 0, pixelBytes);
+  if (redraw)
+  {
+    memset(TRACK_BUFFER(pLayer->pTrack), 0, pixelBytes);
+    pLayer->pTrack->pixOffset = 0;
+    pLayer->pTrack->decayFactor = 0; // until set by the new plugin
+  }
 
   BeginPluginLayer(pLayer);
   return Status_Success;
@@ -0,0 +1,273 @@
+// PixelNut Engine Class Implementation of Parallel Track Rendering
+/*
+    Copyright (c) 2021, Greg de Valois
+    Software License Agreement (MIT License)
+    See license.txt for the terms of this license.
+*/
+// Each track draws only into its own pixel buffer and drawing properties, so all of
+// the tracks that are due in an update can be rendered at the same time. The caller
+// renders along with ENGINE_WORKERS other tasks (FreeRTOS on the ESP32, else POSIX
+// threads for host builds), each taking the next due track until none are left.
+// The workers are created once and shared by all engines: an engine that finds them
+// busy with another one (host builds can update engines on many threads) renders its
+// tracks by itself rather than waiting, and engines without tracks don't use them.
+// Forces sent by plugins while rendering are queued, and triggered in the order of the
+// layers that sent them once all the tracks are done, so the results don't depend on
+// timing (except for plugins using random(), which get values in whatever order they run).
+// The queue starts with room for one force from every layer, and grows if more are sent
+// (only while holding its lock, which is otherwise held just long enough to add one).
+
+#define DEBUG_OUTPUT 0 // 1 enables debugging this file
+
+#include "core.h"
+
+#if ENGINE_WORKERS
+
+#if defined(ESP32)
+#define WORKER_STACK_BYTES      4096        // stack size for each worker task
+#define WORKER_PRIORITY         1           // same as the Arduino loop() task
+typedef SemaphoreHandle_t WorkerSignal;
+typedef SemaphoreHandle_t WorkerLock;
+typedef TaskHandle_t WorkerTask;
+#define SIGNAL_INIT(s)          ((s = xSemaphoreCreateCounting(ENGINE_WORKERS, 0)) != NULL)
+#define SIGNAL_FREE(s)          vSemaphoreDelete(s)
+#define SIGNAL_GIVE(s)          xSemaphoreGive(s)
+#define SIGNAL_TAKE(s)          xSemaphoreTake(s, portMAX_DELAY)
+#define LOCK_INIT(l)            ((l = xSemaphoreCreateMutex()) != NULL)
+#define LOCK_FREE(l)            vSemaphoreDelete(l)
+#define LOCK_TRY(l)             (xSemaphoreTake(l, 0) == pdTRUE)
+#define LOCK_GIVE(l)            xSemaphoreGive(l)
+#define TASK_END(t)             vTaskDelete(t)
+#else
+#include <pthread.h>
+#include <semaphore.h>
+typedef sem_t WorkerSignal;
+typedef pthread_mutex_t WorkerLock;
+typedef pthread_t WorkerTask;
+#define SIGNAL_INIT(s)          (sem_init(&s, 0, 0) == 0)
+#define SIGNAL_FREE(s)          sem_destroy(&s)
+#define SIGNAL_GIVE(s)          sem_post(&s)
+#define SIGNAL_TAKE(s)          sem_wait(&s)
+#define LOCK_INIT(l)            (pthread_mutex_init(&l, NULL) == 0)
+#define LOCK_FREE(l)            pthread_mutex_destroy(&l)
+#define LOCK_TRY(l)             (pthread_mutex_trylock(&l) == 0)
+#define LOCK_GIVE(l)            pthread_mutex_unlock(&l)
+#define TASK_END(t)             { pthread_cancel(t); pthread_join(t, NULL); } // waiting is a cancel point
+#endif
+
+class PixelNutWorkers
+{
+public:
+  static PixelNutWorkers *thePool;              // shared by all engines, created by the first
+  static bool creating;                         // set while checking for or creating it
+
+  WorkerLock lockPool;                          // held by the engine using the workers
+  PixelNutEngine *pEngine;                      //  which is this one
+  WorkerSignal sigStart;                        // given once for each worker to start
+  WorkerSignal sigDone;                         // given by each worker when finished
+  WorkerTask tasks[ENGINE_WORKERS];
+  int countTasks;                               // number of those that were started
+  PixelNutEngine::DrawContext contexts[ENGINE_WORKERS];
+
+  // Creates the pool if not already: engines may be initialized on different threads,
+  // so only one of them at a time checks for it, the others waiting until that's done.
+  static bool Create(void)
+  {
+    while (__atomic_test_and_set(&creating, __ATOMIC_ACQUIRE)) {}
+    bool done = (thePool != NULL) || CreatePool();
+    __atomic_clear(&creating, __ATOMIC_RELEASE);
+    return done;
+  }
+
+  static bool CreatePool(void)
+  {
+    PixelNutWorkers *pool = new PixelNutWorkers;
+    if (pool == NULL) return false;
+    pool->countTasks = 0;
+
+    if (!LOCK_INIT(pool->lockPool))
+    {
+      delete pool;
+      return false;
+    }
+    if (!SIGNAL_INIT(pool->sigStart))
+    {
+      LOCK_FREE(pool->lockPool);
+      delete pool;
+      return false;
+    }
+    if (!SIGNAL_INIT(pool->sigDone))
+    {
+      SIGNAL_FREE(pool->sigStart);
+      LOCK_FREE(pool->lockPool);
+      delete pool;
+      return false;
+    }
+
+    thePool = pool; // before the workers use it
+    for (int i = 0; i < ENGINE_WORKERS; ++i)
+    {
+      PixelNutEngine::DrawContext *pc = &pool->contexts[i];
+      pc->pEngine = NULL; // set when started
+      pc->pDrawPixels = NULL;
+      pc->pTrack = NULL;
+      pc->pLayer = NULL;
+
+      #if defined(ESP32)
+      bool started = (xTaskCreate(WorkerMain, "PixelNutWorker", WORKER_STACK_BYTES,
+                                  pc, WORKER_PRIORITY, &pool->tasks[i]) == pdPASS);
+      #else
+      bool started = (pthread_create(&pool->tasks[i], NULL, ThreadMain, pc) == 0);
+      #endif
+      if (!started)
+      {
+        pool->Release();
+        delete pool;
+        thePool = NULL;
+        return false;
+      }
+      ++pool->countTasks;
+    }
+
+    DBGOUT((F("Engine workers: %d"), ENGINE_WORKERS));
+    return true;
+  }
+
+  void Release(void)                            // ends the workers and frees the signals
+  {
+    for (int i = 0; i < countTasks; ++i) TASK_END(tasks[i]);
+    countTasks = 0;
+
+    SIGNAL_FREE(sigDone);
+    SIGNAL_FREE(sigStart);
+    LOCK_FREE(lockPool);
+  }
+
+  static void WorkerMain(void *param)           // runs forever for each worker
+  {
+    PixelNutEngine::DrawContext *pc = (PixelNutEngine::DrawContext*)param;
+
+    while (true)
+    {
+      SIGNAL_TAKE(thePool->sigStart);
+      pc->pEngine = thePool->pEngine;
+      pc->pEngine->RenderDueTracks(pc);
+      SIGNAL_GIVE(thePool->sigDone);
+    }
+  }
+
+  #if !defined(ESP32)
+  static void *ThreadMain(void *param) { WorkerMain(param); return NULL; }
+  #endif
+};
+
+PixelNutWorkers *PixelNutWorkers::thePool = NULL;
+bool PixelNutWorkers::creating = false;
+
+bool PixelNutEngine::InitWorkers(void)
+{
+  if (maxPluginTracks <= 0) return true; // never has anything to render
+
+  pDueTracks = (PluginTrack**)malloc(maxPluginTracks * sizeof(PluginTrack*));
+  pPendForces = (PendingForce*)malloc(maxPluginLayers * sizeof(PendingForce));
+  maxPendForces = maxPluginLayers;
+
+  if ((pDueTracks == NULL) || (pPendForces == NULL) || !PixelNutWorkers::Create())
+  {
+    if (pDueTracks != NULL)  free(pDueTracks);
+    if (pPendForces != NULL) free(pPendForces);
+    pDueTracks = NULL;
+    pPendForces = NULL;
+    return false;
+  }
+
+  return true;
+}
+
+// called by each worker and the caller: renders tracks until there are none left
+void PixelNutEngine::RenderDueTracks(DrawContext *pc)
+{
+  while (true)
+  {
+    short index = __atomic_fetch_add(&nextDueTrack, 1, __ATOMIC_RELAXED);
+    if (index >= countDueTracks) break;
+
+    RenderTrack(pDueTracks[index], pc);
+  }
+}
+
+// called from SendForce() by a plugin being rendered: queues the force, making room for it
+// if the queue is full (only if there's no memory for that is it dropped)
+void PixelNutEngine::QueueForce(DrawContext *pc, uint16_t id, byte force)
+{
+  while (__atomic_test_and_set(&lockPendForces, __ATOMIC_ACQUIRE)) {}
+
+  if (countPendForces >= maxPendForces)
+  {
+    int count = 2 * maxPendForces;
+    if (count > 0x7FFF) count = 0x7FFF; // most a short can count
+
+    PendingForce *pforces = NULL;
+    if (count > countPendForces)
+      pforces = (PendingForce*)realloc(pPendForces, (count * sizeof(PendingForce)));
+
+    if (pforces == NULL)
+    {
+      __atomic_clear(&lockPendForces, __ATOMIC_RELEASE);
+      DBGOUT((F("Force dropped: layer=%d id=%d"), LAYER_INDEX(pc->pLayer), id));
+      return;
+    }
+
+    pPendForces = pforces;
+    maxPendForces = count;
+  }
+
+  PendingForce *pend = pPendForces + countPendForces++;
+  pend->id = id;
+  pend->force = force;
+  pend->layer = LAYER_INDEX(pc->pLayer);
+
+  __atomic_clear(&lockPendForces, __ATOMIC_RELEASE);
+}
+
+// renders all of the tracks in 'pDueTracks', then triggers any forces sent while doing so
+void PixelNutEngine::RenderParallel(void)
+{
+  PixelNutWorkers *pool = PixelNutWorkers::thePool;
+  int workers = countDueTracks - 1; // caller renders one of the tracks itself
+  if (workers > ENGINE_WORKERS) workers = ENGINE_WORKERS;
+  if ((workers > 0) && !LOCK_TRY(pool->lockPool)) workers = 0; // used by another engine
+
+  nextDueTrack = 0;
+  countPendForces = 0;
+
+  if (workers > 0)
+  {
+    pool->pEngine = this;
+    for (int i = 0; i < workers; ++i) SIGNAL_GIVE(pool->sigStart);
+  }
+
+  RenderDueTracks(&drawContext);
+
+  if (workers > 0)
+  {
+    for (int i = 0; i < workers; ++i) SIGNAL_TAKE(pool->sigDone);
+    LOCK_GIVE(pool->lockPool);
+  }
+
+  // put the forces in the order of the layers that sent them (each layer sends in order)
+  int count = countPendForces;
+  for (int i = 1; i < count; ++i)
+  {
+    PendingForce pend = pPendForces[i];
+    int j = i;
+    for (; (j > 0) && (pPendForces[j-1].layer > pend.layer); --j)
+      pPendForces[j] = pPendForces[j-1];
+    pPendForces[j] = pend;
+  }
+
+  for (int i = 0; i < count; ++i)
+    triggerForce(pPendForces[i].id, pPendForces[i].force);
+}
+
+#endif // ENGINE_WORKERS
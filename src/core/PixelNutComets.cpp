@@ -16,39 +16,45 @@ PixelNutComets pixelNutComets;    // single statically allocated object instance
 // Internally used defines and data structures
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-typedef struct ATTR_PACKED
-{
-  bool dowrap;                  // true to allow wrapping, false to fall off end
-  bool offend;                  // false until head wraps or has gone off the end
-  int16_t curpos;               // current head position (from 0)
-  int16_t maxlen;               // max length of tail (distance to next head)
-  int16_t prevlen;              // previous tail length (used to clear if shortened)
-}
-CometHead;        // defines a head for the comet effect
-C_ASSERT(sizeof(CometHead) == 8);
+// The heads are kept in separate arrays, indexed by head number. Those in use are kept in
+// 'order' (a ring of head numbers) sorted from the one furthest along to the one nearest
+// the start, which stays sorted as they all advance together, and those that are not are
+// linked together in a free list through 'next', so that adding one doesn't search.
+// Each tail is only drawn back as far as the head following it ('maxlen'), so each step
+// draws every pixel at most once however many heads there are.
+#define HEAD_NONE         0xFFFF    // end of the free list
+
+#define HeadFlag_DoWrap   1         // set to allow wrapping, else falls off end
+#define HeadFlag_OffEnd   2         // clear until head wraps or has gone off the end
 
 typedef struct ATTR_PACKED
 {
-  byte count;                   // number of heads that are supported
-  byte inuse;                   // number of heads currently in use
-  CometHead heads[0];           // internally allocated head data starts here
+  uint16_t count;               // number of heads that are supported
+  uint16_t inuse;               // number of heads currently in use
+  uint16_t first;               // index into 'order' of the head furthest along
+  uint16_t freehead;            // first unused head, or HEAD_NONE if none
+
+  uint32_t *curpos;             // current position of each head (from 0)
+  uint16_t *maxlen;             // max length of tail (distance to following head)
+  uint16_t *prevlen;            // previous tail length (used to clear if shortened)
+  uint16_t *next;               // next unused head for those in the free list
+  uint16_t *order;              // heads in use, from furthest along to nearest start
+  byte *flags;                  // HeadFlag_xx bits for each head
+
+  // arrays are internally allocated after this
 }
 CometHeadData;   // defines data for list of heads for the comet effect
-C_ASSERT(sizeof(CometHeadData) == 2);
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
 PixelNutComets::cometData PixelNutComets::cometHeadCreate(int headcount)
 {
-  void *memptr;
-  int memlen = 0;
+  if ((headcount < 1) || (headcount >= HEAD_NONE)) return NULL;
 
-  while(1)
+  int memlen = sizeof(CometHeadData) + (headcount * (sizeof(uint32_t) + (4 * sizeof(uint16_t)) + sizeof(byte)));
+  void *memptr = malloc(memlen);
+  if (memptr == NULL)
   {
-    memlen = (sizeof(CometHeadData) + (headcount * sizeof(CometHead)));
-    memptr = malloc(memlen);
-    if (memptr != NULL) break;
-
     DBGOUT ((F("Cannot allocate %d bytes for comet heads"), memlen));
     return NULL;
   }
@@ -56,14 +62,20 @@ PixelNutComets::cometData PixelNutComets::cometHeadCreate(int headcount)
   CometHeadData *pData = (CometHeadData*)memptr;
   pData->count = headcount;
   pData->inuse = 0;
+  pData->first = 0;
+  pData->freehead = 0;
 
-  CometHead *phead = pData->heads;
-  for (int i = 0; i < headcount; ++i, ++phead)
-  {
-    // clear to unused status
-    phead->dowrap = false;
-    phead->offend = true;
-  }
+  // arrays in order of alignment
+  pData->curpos  = (uint32_t*)(pData + 1);
+  pData->maxlen  = (uint16_t*)(pData->curpos + headcount);
+  pData->prevlen = pData->maxlen + headcount;
+  pData->next    = pData->prevlen + headcount;
+  pData->order   = pData->next + headcount;
+  pData->flags   = (byte*)(pData->order + headcount);
+
+  // all are unused
+  for (int i = 0; i < headcount; ++i) pData->next[i] = i+1;
+  pData->next[headcount-1] = HEAD_NONE;
 
   DBGOUT((F("Allocated %d bytes for %d comet heads"), memlen, headcount));
   return (PixelNutComets::cometData)pData;
@@ -79,109 +91,50 @@ void PixelNutComets::cometHeadDelete(PixelNutComets::cometData cdata)
   }
 }
 
-// adds new head or overwrites existing one if no more room, returns number of heads currently in use
+// adds new head if there's room, returns number of heads currently in use
 int PixelNutComets::cometHeadAdd(PixelNutComets::cometData cdata, bool dowrap, int pixlen)
 {
   if (cdata == NULL) return 0;
 
   CometHeadData *pData = (CometHeadData*)cdata;
-  CometHead *phead = pData->heads;
-  int maxheads = pData->count;
-
-  #if DEBUG_OUTPUT
-  DBGOUT((F("AddHead: Count=%d/%d"), pData->inuse, maxheads));
-  DBGOUT((F("  Before:")));
-  for (int i = 0; i < maxheads; ++i)
-  {
-    if (phead[i].dowrap || !phead[i].offend)
-         DBGOUT((F("  #%d: DoWrap=%d OffEnd=%d CurPos=%-3d MaxLen=%-3d"), i,
-                phead[i].dowrap, phead[i].offend, phead[i].curpos, phead[i].maxlen));
-    //else DBGOUT((F("  #%d: unused"), i));
-  }
-  #endif
-
-  // find empty slot or one with minimum position:
-
-  int index = 0;
-  int minpos = pixlen;
-  bool doinsert = false;
+  int last = pData->first + pData->inuse;
+  if (last >= pData->count) last -= pData->count;
 
-  for (int i = 0; i < maxheads; ++i)
+  // don't add if already have head at starting position, which would be the last one
+  int prev = -1;
+  if (pData->inuse > 0)
   {
-    if (!phead[i].dowrap && phead[i].offend) // unused slot
-    {
-      doinsert = true;
-      ++pData->inuse;
-      index = i;
-      break;
-    }
-
-    if (phead[i].curpos == 0) // already have head at starting position
-      return pData->inuse;
-
-    if (minpos > phead[i].curpos)
-    {
-      minpos = phead[i].curpos;
-      index = i;
-    }
+    prev = (last > 0) ? (last - 1) : (pData->count - 1);
+    if (pData->curpos[pData->order[prev]] == 0) return pData->inuse;
   }
 
   // return if no empty slots
-  if (!doinsert) return pData->inuse;
-
-  // now find the minimum position excluding one just chosen:
+  uint16_t head = pData->freehead;
+  if (head == HEAD_NONE) return pData->inuse;
+  pData->freehead = pData->next[head];
 
-  int next_index = -1;
   int maxlen = pixlen;
-  minpos = pixlen;
-
-  for (int i = 0; i < maxheads; ++i)
+  if (prev >= 0) // if there's a head in front of this new one (the one nearest the start)
   {
-    if (i == index) continue; // skip new one
-
-    if (phead[i].dowrap || !phead[i].offend) // is in use
-    {
-      if (minpos > phead[i].curpos)
-      {
-        minpos = phead[i].curpos;
-        next_index = i;
-      }
-    }
-  }
+    uint16_t ahead = pData->order[prev];
 
-  // if there's a head in front of this new one,
-  // adjust its length and set maxlen for new one:
+    // when wrapping the new head takes what is left of the gap behind the head in front,
+    // else it has the whole window until another new head comes after
+    if (dowrap) maxlen = (pData->maxlen[ahead] - pData->curpos[ahead]);
+    if (maxlen <= 0) maxlen = pixlen; // head in front has fallen off the end
 
-  if (next_index >= 0)
-  {
-    if (!dowrap)
-         maxlen = pixlen; // until new head comes after
-    else if (doinsert)
-         maxlen = (phead[next_index].maxlen - phead[next_index].curpos);
-    else maxlen = (phead[index].maxlen - phead[index].curpos);
-
-    // next head's length is exactly it's current position since new one starts at 0
-    phead[next_index].maxlen = phead[next_index].curpos;
+    // head in front's length is exactly it's current position since new one starts at 0
+    pData->maxlen[ahead] = pData->curpos[ahead];
   }
 
-  phead[index].dowrap  = dowrap;    // true to allow wrapping
-  phead[index].offend  = false;     // true once went off end or wrapped
-  phead[index].curpos  = 0;         // always starts at 0
-  phead[index].maxlen  = maxlen;    // distance to the next head
-  phead[index].prevlen = 0;         // no previous length yet
-
-  #if DEBUG_OUTPUT
-  DBGOUT((F("  After:")));
-  for (int i = 0; i < maxheads; ++i)
-  {
-    if (phead[i].dowrap || !phead[i].offend)
-         DBGOUT((F("  #%d: DoWrap=%d OffEnd=%d CurPos=%-3d MaxLen=%-3d%s"), i,
-                phead[i].dowrap, phead[i].offend, phead[i].curpos, phead[i].maxlen,
-                ((i == index) ? "<==" : "")));
-    //else DBGOUT((F("  #%d: unused"), i));
-  }
-  #endif
+  pData->curpos[head] = 0; // always starts at 0
+  pData->maxlen[head] = maxlen;
+  pData->prevlen[head] = 0; // no previous length yet
+  pData->flags[head] = (dowrap ? HeadFlag_DoWrap : 0);
+  pData->order[last] = head;
+  ++pData->inuse;
 
+  DBGOUT((F("AddHead: #%d DoWrap=%d Count=%d/%d"), head, dowrap, pData->inuse, pData->count));
   return pData->inuse;
 }
 
@@ -193,49 +146,61 @@ int PixelNutComets::cometHeadDraw(PixelNutComets::cometData cdata,
   if (cdata == NULL) return 0;
 
   CometHeadData *pData = (CometHeadData*)cdata;
-  CometHead *phead = pData->heads;
+  uint16_t count = pData->count;
+
+  // establish max brightness that is faded to black along tails
+  float bright = ((float)pdraw->pcentBright / MAX_PERCENTAGE);
+
+  // step through the heads in order, putting those still going back into the ring
+  // behind the others, except that the ones that wrap back to the start go last
+  uint16_t wrapped = HEAD_NONE;  // list of those that wrapped, linked through 'next'
+  uint16_t *wraptail = &wrapped;
+  int steps = pData->inuse;
+  int last = pData->first + pData->inuse;
+  if (last >= count) last -= count;
 
-  for (int headnum = 0; headnum < pData->count; ++headnum, ++phead)
+  for (int i = 0; i < steps; ++i)
   {
-    if (!phead->dowrap && phead->offend) // don't draw this head
-      continue;
+    uint16_t head = pData->order[pData->first];
+    if (++pData->first >= count) pData->first = 0;
+    --pData->inuse;
 
-    #if 0 //DEBUG_OUTPUT
-    int startbodylen = pdraw->pixCount;
-    #endif
-  
     int bodylen = pdraw->pixCount;
     if (bodylen == 1) bodylen = 2; // minimum body length (to clear previous body)
     int fadelen = bodylen-1;       // fade down tail with last pixel dark
-  
-    if (bodylen > phead->maxlen)   // if longer than length to following head
+
+    if (bodylen > pData->maxlen[head])    // if longer than length to following head
     {
-        bodylen = phead->maxlen;   // shorten to avoid overwriting it
-        fadelen = bodylen;         // fade into that following head
+        bodylen = pData->maxlen[head];    // shorten to avoid overwriting it
+        fadelen = bodylen;                // fade into that following head
     }
     else
-    if (bodylen < phead->prevlen)  // body has been shorted since last time
-        bodylen = phead->prevlen;  // lengthen to avoid leaving a trail
-                                   // but keep fadelen so erases that
+    if (bodylen < pData->prevlen[head])   // body has been shorted since last time
+    {
+        bodylen = pData->prevlen[head];   // lengthen to avoid leaving a trail
+                                          // but keep fadelen so erases that
+        if (bodylen > pData->maxlen[head])
+            bodylen = pData->maxlen[head]; // but still not into following head
+    }
 
-    phead->prevlen = pdraw->pixCount; // save current count for next time
+    pData->prevlen[head] = pdraw->pixCount; // save current count for next time
 
-    int headpos = phead->curpos;   // current position of the head
+    int headpos = pData->curpos[head];    // current position of the head
 
-    if (!phead->offend)
+    if (!(pData->flags[head] & HeadFlag_OffEnd))
     {
       // adjust for new head just starting out so don't wrap around
       // (but don't adjust fade length so body grows naturally)
       if (bodylen > (headpos + 1))
           bodylen = (headpos + 1); // grow body each time
     }
-  
-    // establish max brightness and fade to black along tail
-    float fade_scale = ((float)pdraw->pcentBright / MAX_PERCENTAGE);
+
+    float fade_scale = bright;
     float fade_step = (fade_scale / fadelen);
-  
+
     int curpos = headpos;
     int drawlen = bodylen; // drawing entire body, unless...
+    int drawmax = bodylen;
 
     if (headpos >= pixlen) // fallen off end
     {
@@ -249,53 +214,63 @@ int PixelNutComets::cometHeadDraw(PixelNutComets::cometData cdata,
         fade_scale -= (adjustpos * fade_step);
         if (fade_scale < 0) fade_scale = 0;
       }
-  
+
       curpos = pixlen-1; // start at ending pixel
+
+      // but still stop before following head
+      drawmax = (pData->maxlen[head] - adjustpos - 1);
     }
-  
-    #if 0 //DEBUG_OUTPUT
-    DBGOUT((F("%2d: %sHeadPos=%-3d CurPos=%-3d StartBody=%-3d CurBody=%-3d DrawLen=%-3d FadeLen=%d"),
-              headnum, (phead->offend ? " " : "^"), headpos, curpos, startbodylen, bodylen, drawlen, fadelen));
-    //DBGOUT((F("    Fade(Scale=%-3d%% Step=%-3d%% Len=%d)"), (int)(fade_scale*100), (int)(fade_step*100), fadelen));
-    #endif
-  
+
     if (drawlen > 0)
     {
-      while(1)
+      if (drawlen > drawmax) drawlen = drawmax;
+
+      while (drawlen > 0)
       {
-        //DBGOUT((F("  %3d: DrawLen=%3d Scale=%3d%%"), curpos, drawlen, (int)(fade_scale*100)));
-  
         pixelNutSupport.setPixel(handle, curpos, pdraw->r, pdraw->g, pdraw->b, fade_scale);
-  
+
         if (!--drawlen) break;
 
         if (--curpos < 0) curpos = pixlen-1;
-  
+
         fade_scale -= fade_step;
         if (fade_scale < 0) fade_scale = 0;
       }
 
-      phead->curpos = ++headpos;
+      pData->curpos[head] = ++headpos;
     }
     // else nothing to draw
 
-    if (phead->dowrap) // if are wrapping check if at the end now
+    if (pData->flags[head] & HeadFlag_DoWrap) // if are wrapping check if at the end now
     {
       if (headpos >= pixlen)
       {
-        phead->curpos = 0;
-        phead->offend = true;
+        pData->curpos[head] = 0;
+        pData->flags[head] |= HeadFlag_OffEnd;
+        *wraptail = head;
+        wraptail = &pData->next[head];
+        continue;
       }
     }
-    else // if not wrapping check if body is completely done
+    else if (headpos >= (pixlen + bodylen)) // if not wrapping check if body is completely done
     {
-      if (headpos >= (pixlen + bodylen))
-      {
-        --pData->inuse;
-        phead->offend = true;
-        DBGOUT((F("Done: H%d(%d more) headpos=%d bodylen=%d"), headnum, pData->inuse, headpos, bodylen));
-      }
+      pData->next[head] = pData->freehead;
+      pData->freehead = head;
+      DBGOUT((F("Done: H%d(%d more) headpos=%d bodylen=%d"), head, (pData->inuse + (steps-i-1)), headpos, bodylen));
+      continue;
     }
+
+    pData->order[last] = head;
+    if (++last >= count) last = 0;
+    ++pData->inuse;
+  }
+
+  *wraptail = HEAD_NONE;
+  for (uint16_t head = wrapped; head != HEAD_NONE; head = pData->next[head])
+  {
+    pData->order[last] = head;
+    if (++last >= count) last = 0;
+    ++pData->inuse;
   }
 
   return pData->inuse;
@@ -11,7 +11,7 @@
 // Routines for drawing comets effects:
 // Create: assigns data space to hold requested heads, returns NULL if failed
 // Delete: must be called by plugin destructor to clean up any memory allocated
-// Add: creates new head, or overwrites old one if already reached the maximum
+// Add: creates new head, unless already reached the maximum or one is just starting
 //      ('dowrap' controls whether or not comet wraps around, or falls off end)
 // Draw: draws all heads given draw settings, returns true if anything drawn
 //       (length of comet is controlled by "pixCount" parameter in DrawProps)
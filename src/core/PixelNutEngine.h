@@ -6,6 +6,34 @@
 
 #pragma once
 
+// Layout of the pixels as a 2D matrix of 'width' columns and 'height' rows, with row 0 at the
+// top, given to PixelNutEngine::init() so that plugins can draw in 2 dimensions. By default
+// pixels are wired a row at a time from the top left, all in the same direction:
+#define LAYOUT_SERPENTINE       1           // every other row (or column) runs the other way
+#define LAYOUT_COLUMNS          2           // wired a column at a time instead of a row
+#define LAYOUT_TABLE            4           // 'ptable' has the pixel of each x,y in row order
+#define LAYOUT_NO_PIXEL         0xFFFF      // in tables, where there is no pixel at that x,y
+
+typedef struct
+{
+  uint16_t width, height;                   // columns and rows of the matrix
+  byte flags;                               // LAYOUT_xx bits
+  const uint16_t *ptable;                   // XY table in program memory (PROGMEM), or NULL
+}
+PixelLayout;
+
+// Copies part of the pixels displayed by one engine to another strand, or to another part of
+// its own strand, so that the same effect is shown in more than one place for only the cost
+// of the copy (see PixelNutEngine::cloneOutput).
+typedef struct
+{
+  byte source, dest;                        // strand rendered, and strand copied to (may be the same)
+  uint16_t srcPos, count;                   // first of the rendered pixels, and how many
+  uint16_t destPos;                         // where the first of them is copied to
+  int16_t destStep;                         // to each next one: 1 copies, -1 reverses, >1 spreads out
+}
+PixelClone;
+
 class PixelNutEngine
 {
 public:
@@ -39,12 +67,14 @@ public:
   // initializer: set number and length of the pixels to be drawn, 
   // the first pixel to start drawing and the direction of drawing,
   // and the maximum effect layers and tracks that can be supported.
-  // returns false if failed (not enough memory)
+  // A 'layout' has the pixels drawn as a matrix, else they are a single row.
+  // returns false if failed (not enough memory, or 'pixel_bytes' isn't PIXEL_BYTES)
   bool init(uint16_t num_pixels, byte pixel_bytes,
             byte num_layers, byte num_tracks,
-            uint16_t first_pixel=0, bool backwards=false);
+            uint16_t first_pixel=0, bool backwards=false,
+            const PixelLayout *layout=NULL);
 
-  void setBrightPercent(byte percent) { pcentBright = percent; }
+  void setBrightPercent(byte percent) { pcentBright = percent; WakeAllTracks(); }
   byte getBrightPercent() { return pcentBright; }
 
   void setDelayPercent(byte percent) { pcentDelay = percent; }
@@ -55,6 +85,7 @@ public:
     if (pixpos < 0) pixpos = 0;
     if (numPixels <= pixpos) pixpos = numPixels-1;
     firstPixel = pixpos;
+    WakeAllTracks(); // so the display is updated
   }
   uint16_t getFirstPosition() { return firstPixel; }
 
@@ -95,10 +126,21 @@ public:
   // Updates current effect: returns true if the pixels have changed and should be redisplayed.
   virtual bool updateEffects(void);
 
+  // Returns msecs until updateEffects() next has something to do (0 if now), from either a
+  // track redraw or a repeat trigger, or ENGINE_NEVER_DUE if only an external event can
+  // change the pixels (a command, property change, or trigger), which callers must watch for.
+  #define ENGINE_NEVER_DUE  0xFFFFFFFF
+  uint32_t msecsUntilDue(void);
+
+  // Copies the pixels of 'pclone' from those displayed into 'pdest', a buffer of 'dest_pixels'
+  // pixels (usually that of another strand), after updateEffects() has changed them. Pixels
+  // that would fall outside of either buffer are skipped.
+  void cloneOutput(const PixelClone *pclone, byte *pdest, uint16_t dest_pixels);
+
   // Used to access main display buffer and related parameters.
-  byte *pDrawPixels;    // current pixel buffer to draw into or display
+  byte *pDrawPixels;    // pixel buffer to be displayed
   uint16_t numPixels;   // number of pixels in output buffer
-  uint16_t pixelBytes;  // total bytes for all pixels
+  uint32_t pixelBytes;  // total bytes for all pixels
 
 protected:
 
@@ -121,13 +163,18 @@ protected:
   #define ENABLEBIT_SOLO    2   // layer has solo enabled
 
   #define LAYER_BYTES       (sizeof(PluginLayer))
-  #define LAYER_INDEX(p)    (p - pluginLayers) // debug only
+  #define LAYER_INDEX(p)    (p - pluginLayers)
 
   #define TRACK_BYTES       (sizeof(PluginTrack) + pixelBytes)
   #define TRACK_INDEX(p)    (((byte*)p - (byte*)pluginTracks)/TRACK_BYTES) // debug only
   #define TRACK_MAKEPTR(i)  (PluginTrack*)((i * TRACK_BYTES) + (byte*)pluginTracks)
   #define TRACK_BUFFER(p)   ((byte*)(p + 1))
 
+  // Number of pixels merged into the display at a time: all of the tracks are merged into
+  // one block before the next, so for long strands the block stays in the cache. Strands
+  // up to this length are done in a single pass.
+  #define COMPOSITE_PIXELS  512
+
   // saves what triggering is enabled
   enum TrigTypeBit
   {
@@ -137,11 +184,60 @@ protected:
     TrigTypeBit_Repeating    = 8,   // auto-repeating   ("R" command)
   };
 
+  #if NUM_MODULATORS
+  // Modulators are oscillators (LFOs) and envelopes shared by all tracks, each advanced once
+  // per update, that are routed with the "P" commands to modulate the drawing properties of
+  // tracks: the output (+/-MOD_OUTPUT_ONE, envelopes are only positive) scaled by the depth of
+  // the route is added to the property value only while the track is being drawn.
+  #define MOD_OUTPUT_ONE    32767 // full output, Q15 fixed point
+  #define DEF_MOD_MSECS     2000  // default cycle time (or envelope decay time)
+
+  enum ModShape
+  {
+    ModShape_Off = 0,               // not used ("PS" or "PS0")
+    ModShape_Sine,                  // "PS1"
+    ModShape_Triangle,              // "PS2"
+    ModShape_Square,                // "PS3"
+    ModShape_Sawtooth,              // "PS4": ramps up, then drops
+    ModShape_Envelope,              // "PS5": jumps to trigger force, then decays to 0
+  };
+
+  enum ModProp                      // modulated property, routed by the command:
+  {
+    ModProp_Bright = 0,             //  "PB<percent>"
+    ModProp_Hue,                    //  "PH<degrees>"
+    ModProp_White,                  //  "PW<percent>"
+    ModProp_Count,                  //  "PC<percent>" (of all the pixels)
+    ModProp_Delay,                  //  "PD<percent>"
+  };
+
+  typedef struct
+  {
+    byte shape;                                 // waveform (ModShape_xx)
+    bool active;                                // envelope: true from trigger until decayed
+    uint16_t msecsPeriod;                       // cycle (or decay) time in msecs
+    uint32_t phaseRate;                         // phase advance per msec
+    uint32_t phase;                             // position in the cycle (2^32 is a full cycle)
+    int16_t peak;                               // envelope: output when triggered
+    int16_t output;                             // current output value
+  }
+  Modulator;
+
+  typedef struct ATTR_PACKED
+  {
+    byte modprop;                               // modulator index (high nibble), ModProp_xx (low)
+    int16_t depth;                              // property change at full output, 0 if not used
+  }
+  ModRoute;
+
+  Modulator modulators[NUM_MODULATORS];
+  #endif
+
   byte pcentBright = MAX_BRIGHTNESS;            // percent brightness to apply to each effect
   byte pcentDelay  = MAX_PERCENTAGE/2;          // percent delay to apply to each effect
 
   struct ATTR_PACKED _PluginTrack;
-  typedef struct ATTR_PACKED // 30-34 bytes
+  typedef struct ATTR_PACKED // 31-35 bytes
   {
     struct _PluginTrack *pTrack;                // pointer to track for this layer
     PixelNutPlugin *pPlugin;                    // pointer to the created plugin object
@@ -165,27 +261,57 @@ protected:
     uint16_t trigRepRange;                      // range of delay values possible (min...min+range)
 
     uint16_t thisLayerID;                       // unique identifier for this layer
+    bool idle;                                  // true if plugin has nothing to do until woken
   }
   PluginLayer; // defines each layer of effect plugin
 
-  typedef struct ATTR_PACKED _PluginTrack // 26-28 bytes + pixelbuffer
+  typedef struct ATTR_PACKED _PluginTrack // 30-32 bytes + modulator routes + pixelbuffer
   {
     PluginLayer *pLayer;                        // pointer to layer for this track
 
     PixelNutSupport::DrawProps draw;            // drawing properties for this track
     uint32_t msTimeRedraw;                      // time of next redraw of plugin in msecs
+    uint16_t pixOffset;                         // rotation of the pixel buffer: where pixel 0 is
+    uint16_t decayFactor;                       // fade applied to buffer before each step (0 if none)
 
     byte ctrlBits;                              // controls setting properties (ExtControlBit_xx)
     byte lcount;                                // number of layers in this track (>= 1)
 
+    #if NUM_MODULATORS
+    ModRoute modRoutes[MOD_TRACK_ROUTES];       // properties modulated by modulators
+    #endif
+    #if HOST_BUILD
+    uint32_t randState;                         // random() state while drawn or triggered
+    #endif
+
     // pixel buffer starts here
   }
   PluginTrack; // defines properties for each drawing plugin
 
+  // Passed to plugins as their 'PixelNutHandle', used by the support routines to find
+  // the buffer to draw into. Tracks are stepped with 'drawContext', and each parallel
+  // worker has its own, so that tracks being rendered never share a drawing buffer.
+  typedef struct
+  {
+    PixelNutEngine *pEngine;                    // engine that owns the plugin
+    byte *pDrawPixels;                          // buffer to draw into (NULL for filters)
+    PluginTrack *pTrack;                        // track that owns that buffer
+    PluginLayer *pLayer;                        // layer being stepped, NULL if not rendering
+  }
+  DrawContext;
+
+  friend class PixelNutSupport;                 // support routines use the draw context
+  friend class PixelNutWorkers;                 // parallel workers render the tracks
+
+  DrawContext drawContext;                      // context for stepping tracks serially
+
   PluginLayer *pluginLayers;                    // plugin layers that creates effect
   short maxPluginLayers;                        // max number of layers possible
   short indexLayerStack = -1;                   // index into the plugin layers stack
   uint16_t uniqueLayerID = 1;                   // used to identify layers uniquely
+  #if HOST_BUILD
+  uint32_t randSeed;                            // seeds the random() state of each track
+  #endif
 
   PluginTrack *pluginTracks;                    // plugin tracks that have properties
   short maxPluginTracks;                        // max number of tracks possible
@@ -197,17 +323,75 @@ protected:
   uint16_t firstPixel = 0;                      // offset to the start of the drawing array
   bool goBackwards = false;                     // false to draw from start to end, else reverse
 
-  byte numBytesPerPixel;                        // number of bytes needed for each pixel
   byte *pDisplayPixels;                         // pointer to actual output display pixels
 
+  #if ENGINE_WORKERS
+  typedef struct                                // force sent by a plugin while rendering:
+  {
+    uint16_t id;                                //  ID of the layers it's sent to
+    byte force;                                 //  the force value
+    short layer;                                //  index of the layer that sent it
+  }
+  PendingForce;
+
+  PluginTrack **pDueTracks = NULL;              // tracks to be redrawn in this update
+  short countDueTracks = 0;                     // number of those tracks
+  short nextDueTrack;                           // index of next one to be taken by a worker
+  PendingForce *pPendForces = NULL;             // forces sent while rendering
+  short maxPendForces = 0;                      // room for that many (grows if needed)
+  short countPendForces = 0;                    // number of those sent
+  bool lockPendForces = false;                  // set while adding to them
+  #endif
+
+  // The layout is precomputed into the pixel at each x,y and the spans of pixels that make up
+  // each row, so that plugins needn't calculate (or know) how the matrix is wired.
+  uint16_t layoutWidth, layoutHeight;           // size of the matrix (one row if no layout)
+  uint16_t *pLayoutIndexes;                     // pixel of each x,y in row order (NULL if none)
+  PixelNutSupport::LayoutSpan *pLayoutSpans;    // spans of all rows, in row order
+  uint16_t *pLayoutRows;                        // index of first span of each row (and one more)
+  PixelNutSupport::LayoutSpan lineSpan;         // the single span if no layout
+
   bool externPropMode = false;                  // true to allow external control of properties
   uint16_t externValueHue;                      // externally set values property values
   byte externPcentWhite;
   byte externPcentCount;
 
+  // A plugin that calls setIdle() from nextstep() isn't stepped again until its track is
+  // woken: by a command, an external property change, or a trigger of one of its layers.
+  // A track isn't redrawn at all while its drawing plugin and active filters are all idle.
+  bool TrackIdle(PluginTrack *pTrack);
+  void WakeTrack(PluginTrack *pTrack);
+  void WakeAllTracks(void);
+
+  bool InitLayout(const PixelLayout *layout);
+  uint16_t LayoutPixel(const PixelLayout *layout, uint16_t x, uint16_t y);
+  int LayoutRowSpans(uint16_t y, PixelNutSupport::LayoutSpan *pspans);
+
   void RestorePropVals(PluginTrack *pTrack, uint16_t pixCount, uint16_t dvalueHue, byte pcentWhite);
+  void CompositeTrack(PluginTrack *pTrack, int first, int last);
   void OverridePropVals(PluginTrack *pTrack);
 
+  #if NUM_MODULATORS
+  void ClearModulators(void);
+  void UpdateModulators(uint32_t msecs);
+  void TriggerModulator(Modulator *pmod, byte force);
+  Status RouteModulator(PluginTrack *pTrack, byte modprop, int16_t depth);
+  bool TrackModulated(PluginTrack *pTrack);
+  void ModulateTrack(PluginTrack *pTrack);
+  void UnmodulateTrack(PluginTrack *pTrack, PixelNutSupport::DrawProps *pdraw);
+  #endif
+
+  void RenderTrack(PluginTrack *pTrack, DrawContext *pc);
+  void ScheduleRedraw(PluginTrack *pTrack);
+  void SendForce(DrawContext *pc, uint16_t id, byte force);
+
+  #if ENGINE_WORKERS
+  bool InitWorkers(void);
+  void RenderDueTracks(DrawContext *pc);
+  void RenderParallel(void);
+  void QueueForce(DrawContext *pc, uint16_t id, byte force);
+  #endif
+
   void TriggerLayer(PluginLayer *pLayer, byte force);
   void RepeatTriger(void);
 
@@ -230,12 +414,50 @@ protected:
   void DeletePluginLayer(short layer);
 };
 
+// Plugins are looked up by ID in the registry table of a derived factory (given to the constructor),
+// which has the device plugins that are reported to clients, and then in that of the built-in plugins.
+// A device table that reuses the ID of a built-in plugin is rejected, so that none of its plugins are used.
 class PluginFactory
 {
-  public: virtual byte*    pluginList(void) { return NULL; }
-  public: virtual char*    pluginName(uint16_t plugin) { return (char*)"Unknown"; }
-  public: virtual char*    pluginDesc(uint16_t plugin) { return (char*)""; }
-  public: virtual uint16_t pluginBits(uint16_t plugin) { return 0; }
-  public: virtual bool     pluginDraws(uint16_t plugin);
-  public: virtual PixelNutPlugin *pluginCreate(uint16_t plugin);
+  public: PluginFactory(const PluginEntry *ptable=NULL, byte count=0);
+
+  public: byte devicePlugins(void) { return numDevPlugins; }            // number of device plugins
+  public: void deviceEntry(byte index, PluginEntry *pentry);            // copies out entry of one
+
+  public: virtual bool     pluginEntry(uint16_t plugin, PluginEntry *pentry); // false if unknown plugin
+  public: virtual uint16_t pluginBits(uint16_t plugin);                 // capability bits (PNP_EBIT_ values)
+  public: virtual uint16_t pluginSize(uint16_t plugin);                 // object size, 0 if unknown plugin
+  public: virtual bool     pluginDraws(uint16_t plugin);                // true if redraws, else filter
+  public: virtual PixelNutPlugin *pluginCreate(uint16_t plugin);        // NULL if unknown plugin
+
+  // Calls nextstep()/trigger() of the built-in plugins directly instead of through the virtual
+  // interface, so that the small ones are inlined, and calls any others (from derived factories,
+  // which must not reuse the IDs of the built-in plugins) through the interface as usual.
+  public: static void pluginStep(uint16_t plugin, PixelNutPlugin *pPlugin,
+                                 PixelNutHandle handle, PixelNutSupport::DrawProps *pdraw);
+  public: static void pluginTrigger(uint16_t plugin, PixelNutPlugin *pPlugin,
+                                    PixelNutHandle handle, PixelNutSupport::DrawProps *pdraw, byte force);
+
+  private: const PluginEntry *pDevTable;        // registry table of device plugins
+  private: byte numDevPlugins;                  // number of entries in it
 };
+
+#if PLUGIN_DISPATCH
+#define PLUGIN_STEP(pl, h, d)       PluginFactory::pluginStep((pl)->iplugin, (pl)->pPlugin, h, d)
+#define PLUGIN_TRIGGER(pl, h, d, f) PluginFactory::pluginTrigger((pl)->iplugin, (pl)->pPlugin, h, d, f)
+#else
+#define PLUGIN_STEP(pl, h, d)       (pl)->pPlugin->nextstep(h, d)
+#define PLUGIN_TRIGGER(pl, h, d, f) (pl)->pPlugin->trigger(h, d, f)
+#endif
+
+// On host builds tracks are drawn on whichever thread is free, so random() is switched to
+// the track's own state while drawing or triggering it, keeping its sequence repeatable.
+// That is 0 while in use, so a track triggered while being drawn keeps the one in use.
+#if HOST_BUILD
+#define RANDOM_TRACK_BEGIN(pt)      uint32_t prevRandState = randomSwapState((pt)->randState); \
+                                    (pt)->randState = 0
+#define RANDOM_TRACK_END(pt)        (pt)->randState = randomSwapState(prevRandState)
+#else
+#define RANDOM_TRACK_BEGIN(pt)
+#define RANDOM_TRACK_END(pt)
+#endif
@@ -0,0 +1,239 @@
+// PixelNut Per-Pixel Phase Plugin Support Class Implementation
+/*
+    Copyright (c) 2021, Greg de Valois
+    Software License Agreement (MIT License)
+    See license.txt for the terms of this license.
+*/
+
+#define DEBUG_OUTPUT 0 // 1 enables debugging this file
+
+#include "core.h"
+
+#include "core/PixelNutPhases.h"  // support class for the per-pixel phase effects
+PixelNutPhases pixelNutPhases;    // single statically allocated object instance
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// Internally used defines and data structures
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// brightness levels for each phase, already gamma corrected:
+
+static PROGMEM const byte ramp_twinkle[] =
+{
+  0, 1, 1, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 3, // 0x00-0x0F
+  3, 3, 3, 3, 3, 4, 4, 5, 5, 6, 7, 7, 8, 9, 10, 11, // 0x10-0x1F
+  12, 13, 14, 15, 17, 18, 19, 21, 22, 24, 25, 27, 29, 31, 32, 35, // 0x20-0x2F
+  37, 39, 41, 43, 46, 49, 50, 54, 57, 59, 62, 66, 68, 72, 75, 78, // 0x30-0x3F
+  82, 86, 89, 93, 98, 101, 105, 110, 114, 119, 124, 127, 133, 138, 142, 148, // 0x40-0x4F
+  152, 158, 164, 169, 175, 182, 186, 193, 200, 205, 213, 220, 225, 233, 241, 247, // 0x50-0x5F
+  255, 247, 241, 233, 225, 220, 213, 205, 200, 193, 186, 182, 175, 169, 164, 158, // 0x60-0x6F
+  152, 148, 142, 138, 133, 127, 124, 119, 114, 110, 105, 101, 98, 93, 89, 86, // 0x70-0x7F
+  82, 78, 75, 72, 68, 66, 62, 59, 57, 54, 50, 49, 46, 43, 41, 39, // 0x80-0x8F
+  37, 35, 32, 31, 29, 27, 25, 24, 22, 21, 19, 18, 17, 15, 14, 13, // 0x90-0x9F
+  12, 11, 10, 9, 8, 7, 7, 6, 5, 5, 4, 4, 3, 3, 3, 3, // 0xA0-0xAF
+  3, 3, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 1, 1, // 0xB0-0xBF
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0xC0-0xCF
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0xD0-0xDF
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0xE0-0xEF
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0  // 0xF0-0xFF
+};
+
+static PROGMEM const byte ramp_blink[] =
+{
+  255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, // 0x00-0x0F
+  255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, // 0x10-0x1F
+  255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, // 0x20-0x2F
+  255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, // 0x30-0x3F
+  255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, // 0x40-0x4F
+  255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, // 0x50-0x5F
+  255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, // 0x60-0x6F
+  255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, // 0x70-0x7F
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0x80-0x8F
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0x90-0x9F
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0xA0-0xAF
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0xB0-0xBF
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0xC0-0xCF
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0xD0-0xDF
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0xE0-0xEF
+  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0  // 0xF0-0xFF
+};
+
+static PROGMEM const byte ramp_noise[] =
+{
+  21, 34, 5, 8, 73, 131, 162, 109, 64, 17, 79, 75, 34, 101, 49, 119, // 0x00-0x0F
+  2, 4, 142, 3, 78, 14, 2, 60, 184, 40, 210, 31, 78, 10, 47, 182, // 0x10-0x1F
+  3, 2, 14, 29, 81, 2, 2, 3, 37, 30, 193, 67, 33, 186, 70, 9, // 0x20-0x2F
+  110, 142, 58, 68, 3, 16, 33, 77, 156, 122, 22, 49, 14, 8, 2, 249, // 0x30-0x3F
+  10, 90, 74, 10, 73, 225, 115, 43, 102, 160, 182, 61, 2, 152, 120, 115, // 0x40-0x4F
+  93, 73, 59, 3, 52, 36, 9, 21, 171, 102, 29, 69, 29, 3, 48, 52, // 0x50-0x5F
+  54, 173, 255, 14, 11, 55, 46, 133, 50, 3, 3, 96, 79, 112, 4, 180, // 0x60-0x6F
+  138, 43, 36, 66, 2, 46, 109, 42, 186, 74, 102, 22, 96, 3, 31, 3, // 0x70-0x7F
+  24, 2, 158, 220, 9, 164, 107, 39, 68, 2, 3, 17, 112, 34, 16, 19, // 0x80-0x8F
+  54, 13, 18, 173, 3, 215, 160, 12, 2, 2, 7, 218, 89, 133, 4, 36, // 0x90-0x9F
+  152, 215, 33, 220, 223, 109, 32, 3, 15, 93, 26, 104, 244, 220, 27, 189, // 0xA0-0xAF
+  2, 14, 135, 64, 99, 196, 13, 3, 177, 4, 228, 93, 14, 3, 124, 140, // 0xB0-0xBF
+  247, 24, 85, 11, 112, 77, 223, 12, 5, 4, 52, 162, 2, 40, 24, 11, // 0xC0-0xCF
+  21, 8, 23, 3, 252, 4, 223, 92, 137, 25, 236, 9, 16, 35, 2, 236, // 0xD0-0xDF
+  87, 239, 127, 5, 13, 3, 160, 70, 10, 9, 40, 2, 175, 175, 20, 18, // 0xE0-0xEF
+  33, 89, 3, 77, 5, 6, 255, 2, 3, 81, 119, 49, 191, 104, 41, 133  // 0xF0-0xFF
+};
+
+static const byte *ramp_tables[] = { ramp_twinkle, ramp_blink, ramp_noise };
+
+typedef struct ATTR_PACKED
+{
+  byte phase;                   // current place in the cycle
+  byte rate;                    // how fast it moves through the cycle
+}
+PhaseState;       // defines the state of each pixel
+C_ASSERT(sizeof(PhaseState) == 2);
+
+typedef struct
+{
+  uint16_t count;               // number of pixels
+  uint16_t pixcount;            // count the spacing was calculated for
+  byte tick;                    // counts steps, to spread out advances of less than 1
+  byte minrate;                 // range of rates that pixels have
+  byte maxrate;
+  byte *advances;               // phase advance for each rate in that range, for this step
+  byte *mask;                   // bit set for each pixel that is drawn
+  PhaseState *states;           // phase state of each pixel
+  // arrays are internally allocated after this
+}
+PhaseData;       // defines data for all of the pixels
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+
+PixelNutPhases::phaseData PixelNutPhases::phaseCreate(uint16_t count, byte minrate, byte maxrate)
+{
+  if (minrate > maxrate) minrate = maxrate;
+
+  int masklen = (count + 7) / 8;
+  int ratelen = (maxrate - minrate + 1);
+  int memlen = sizeof(PhaseData) + (count * sizeof(PhaseState)) + masklen + ratelen;
+  void *memptr = malloc(memlen);
+  if (memptr == NULL)
+  {
+    DBGOUT((F("Cannot allocate %d bytes for pixel phases"), memlen));
+    return NULL;
+  }
+
+  PhaseData *pData = (PhaseData*)memptr;
+  pData->count = count;
+  pData->pixcount = count;
+  pData->tick = 0;
+  pData->minrate = minrate;
+  pData->maxrate = maxrate;
+  pData->states = (PhaseState*)(pData + 1);
+  pData->mask = (byte*)(pData->states + count);
+  pData->advances = pData->mask + masklen;
+
+  memset(pData->mask, 0xFF, masklen); // all drawn until spacing is set
+
+  for (uint16_t i = 0; i < count; ++i)
+  {
+    pData->states[i].phase = random(0, 256);
+    pData->states[i].rate = random(minrate, maxrate+1);
+  }
+
+  DBGOUT((F("Allocated %d bytes for %d pixel phases"), memlen, count));
+  return (PixelNutPhases::phaseData)pData;
+}
+
+void PixelNutPhases::phaseDelete(PixelNutPhases::phaseData pdata)
+{
+  if (pdata != NULL) free(pdata);
+}
+
+// sets the mask to draw 'pixcount' pixels spaced evenly between those skipped
+void PixelNutPhases::phaseSpacing(PixelNutPhases::phaseData pdata, uint16_t pixcount)
+{
+  PhaseData *pData = (PhaseData*)pdata;
+  if ((pData == NULL) || (pData->pixcount == pixcount)) return;
+
+  uint16_t pixlen = pData->count;
+  pData->pixcount = pixcount;
+  memset(pData->mask, 0, ((pixlen + 7) / 8));
+
+  uint16_t draw = 0, skip = 0;
+  for (uint16_t i = 0; i < pixlen; ++i)
+  {
+    if (!draw && !skip)
+    {
+      if (pixcount <= 1)
+      {
+        draw = 0;
+        skip = pixlen;
+      }
+      else if (pixcount >= pixlen)
+      {
+        draw = pixlen;
+        skip = 0;
+      }
+      else if (pixcount > (pixlen - pixcount))
+      {
+        draw = pixcount / (pixlen - pixcount);
+        skip = 1;
+      }
+      else
+      {
+        draw = 1;
+        skip = (pixlen - pixcount) / pixcount;
+      }
+    }
+
+    if (draw)
+    {
+      --draw;
+      pData->mask[i/8] |= (1 << (i & 7));
+    }
+    else --skip;
+  }
+
+  DBGOUT((F("PixelPhases: count=%d of %d"), pixcount, pixlen));
+}
+
+void PixelNutPhases::phaseDraw(PixelNutPhases::phaseData pdata, PixelNutSupport::DrawProps *pdraw,
+                               PixelNutHandle handle, uint32_t speed, PhaseRamp ramp)
+{
+  PhaseData *pData = (PhaseData*)pdata;
+  if (pData == NULL) return;
+
+  const byte *ptable = ramp_tables[ramp];
+  uint16_t tick = pData->tick++;
+
+  // Each pixel advances in 1/256ths of a phase, so that after 256 steps it has moved
+  // 'advance' phases, found once for each rate, since all pixels with it move the same.
+  byte *padvance = pData->advances;
+  for (uint16_t rate = pData->minrate; rate <= pData->maxrate; ++rate)
+  {
+    uint32_t advance = (rate * speed) / PHASE_SPEED_ONE;
+    if (advance > 0xFFFF) advance = 0xFFFF;
+    *padvance++ = ((advance * (tick + 1)) >> 8) - ((advance * tick) >> 8);
+  }
+  padvance = pData->advances - pData->minrate; // indexed by rate
+
+  byte rgb[SPAN_CHUNK_PIXELS * 3]; // chunk of pixels composed before copying
+  byte *prgb = rgb;
+
+  PhaseState *pstate = pData->states;
+  for (uint16_t i = 0; i < pData->count; ++i, ++pstate)
+  {
+    pstate->phase += padvance[pstate->rate];
+
+    byte level = 0;
+    if (pData->mask[i/8] & (1 << (i & 7)))
+      level = pgm_read_byte(&ptable[pstate->phase]);
+
+    *prgb++ = (pdraw->r * level) / MAX_PIXEL_VALUE;
+    *prgb++ = (pdraw->g * level) / MAX_PIXEL_VALUE;
+    *prgb++ = (pdraw->b * level) / MAX_PIXEL_VALUE;
+
+    uint16_t count = (prgb - rgb) / 3;
+    if ((count == SPAN_CHUNK_PIXELS) || (i == (pData->count-1)))
+    {
+      pixelNutSupport.copyPixels(handle, (i + 1 - count), count, rgb);
+      prgb = rgb;
+    }
+  }
+}
@@ -0,0 +1,43 @@
+// PixelNut Per-Pixel Phase Plugin Support Class Definition
+// Used by effect plugins that animate each pixel separately.
+/*
+    Copyright (c) 2021, Greg de Valois
+    Software License Agreement (MIT License)
+    See license.txt for the terms of this license.
+*/
+
+#pragma once
+
+// Routines for drawing effects where each pixel goes through a cycle of brightness levels
+// on its own, kept as an 8-bit phase and an 8-bit rate for each pixel (2 bytes per pixel):
+// Create: assigns data space for 'count' pixels, with random phases and rates from 'minrate'
+//         to 'maxrate', returns NULL if failed
+// Delete: must be called by plugin destructor to clean up any memory allocated
+// Spacing: selects which pixels are drawn: 'pixcount' of them spread out evenly, with the
+//          others left dark (all of them are drawn if this is never called)
+// Draw: advances the phase of each pixel by its rate times 'speed' (with PHASE_SPEED_ONE a
+//       rate of 256 would advance 1 each step), then draws each in the current color scaled
+//       by the (gamma corrected) level found in the 'ramp' table for its phase
+// Spacing is cheap to call each step, as the pixels drawn are only recalculated if changed.
+
+#define PHASE_SPEED_ONE     256
+
+class PixelNutPhases
+{
+public:
+  enum PhaseRamp
+  {
+    PhaseRamp_Twinkle,  // rises and falls for the first 3/4 of the cycle, dark the rest
+    PhaseRamp_Blink,    // full on for the first half of the cycle, off for the other half
+    PhaseRamp_Noise,    // random levels, all of at least 10%
+  };
+
+  typedef void (*phaseData); // abstracts internal data used for pixels
+  phaseData phaseCreate(uint16_t count, byte minrate, byte maxrate);
+  void phaseDelete(phaseData pdata);
+  void phaseSpacing(phaseData pdata, uint16_t pixcount);
+  void phaseDraw(phaseData pdata, PixelNutSupport::DrawProps *pdraw, PixelNutHandle handle,
+                 uint32_t speed, PhaseRamp ramp);
+};
+
+extern PixelNutPhases pixelNutPhases; // single statically allocated object instance
@@ -25,5 +25,56 @@ public:
 
   // Perform the next step of an effect by this plugin using the current drawing
   // properties. The rate at which this is called depends on the delay property.
-  virtual void nextstep(PixelNutHandle handle, PixelNutSupport::DrawProps *pdraw) {}
+  // Plugins that don't implement this are idle: it's not called again unless woken.
+  virtual void nextstep(PixelNutHandle handle, PixelNutSupport::DrawProps *pdraw)
+    { pixelNutSupport.setIdle(handle); }
 };
+
+// Effect capability bits (these must agree with client defines):
+#define PNP_EBIT_COLOR          0x0001  // changing color changes effect
+#define PNP_EBIT_COUNT          0x0002  // changing count changes effect
+#define PNP_EBIT_DELAY          0x0004  // changing delay changes effect
+#define PNP_EBIT_DIRECTION      0x0008  // changing direction changes effect
+#define PNP_EBIT_ROTATION       0x0010  // changing rotation changes effect
+#define PNP_EBIT_REPTRIGS       0x0020  // repeat triggers changes effect
+#define PNP_EBIT_TRIGFORCE      0x0040  // force used in triggering
+#define PNP_EBIT_SENDFORCE      0x0080  // sends force to other plugins
+                                        // only for filter effects:
+#define PNP_EBIT_ORIDE_HUE      0x0100  // effect overrides hue property
+#define PNP_EBIT_ORIDE_WHITE    0x0200  // effect overrides white property
+#define PNP_EBIT_ORIDE_COUNT    0x0400  // effect overrides count property
+#define PNP_EBIT_ORIDE_DELAY    0x0800  // effect overrides delay property
+#define PNP_EBIT_ORIDE_DIR      0x1000  // effect overrides direction property
+#define PNP_EBIT_ORIDE_EXT      0x2000  // effect overrides start/extent properties
+
+#define PNP_EBIT_REDRAW         0x8000  // set if redraw effect, else filter
+
+// Describes a plugin in a registry table kept in program memory, which is built from a list
+// of "X(id, class, bits, name, desc)" entries, sorted by ID, by expanding it twice: first
+// with PLUGIN_STRINGS to make the name/description strings, then with PLUGIN_ENTRY inside
+// the table's initializer. Read entries with memcpy_P() and their strings with strcpy_P().
+typedef struct
+{
+  uint16_t id;                                  // plugin ID value used in patterns
+  uint16_t bits;                                // capability bits (PNP_EBIT_ values)
+  uint16_t size;                                // size of plugin object in bytes
+  PixelNutPlugin *(*create)(void);              // creates a new instance of the plugin
+  const char *name;                             // name of plugin (in PROGMEM)
+  const char *desc;                             // description of plugin (in PROGMEM)
+}
+PluginEntry;
+
+template <class T> PixelNutPlugin *PluginCreate(void) { return new T; }
+
+#define PLUGIN_STRINGS(id, cls, bits, name, desc) \
+  static PROGMEM const char cls##_Name[] = name; \
+  static PROGMEM const char cls##_Desc[] = desc;
+
+#define PLUGIN_ENTRY(id, cls, bits, name, desc) \
+  { id, bits, sizeof(cls), PluginCreate<cls>, cls##_Name, cls##_Desc },
+
+// for checking at compile time that the entries of a table are sorted by ID
+constexpr bool PluginsInOrder(const PluginEntry *pentry, int count)
+{
+  return (count < 2) || ((pentry[0].id < pentry[1].id) && PluginsInOrder(pentry+1, count-1));
+}
@@ -101,15 +101,104 @@ static void HSVtoRGB(int hue, byte sat, byte val, byte *rptr, byte *gptr, byte *
   *bptr = GammaCorrection(b * MAX_PIXEL_VALUE);
 }
 
-static PixelValOrder *pPixOrder;
+// reverses the order of 'count' pixels
+static void ReversePixels(byte *ppixs, int count)
+{
+  byte *pend = ppixs + ((count-1) * PIXEL_BYTES);
+  for (; ppixs < pend; ppixs += PIXEL_BYTES, pend -= PIXEL_BYTES)
+    for (int i = 0; i < PIXEL_BYTES; ++i)
+    {
+      byte val = ppixs[i];
+      ppixs[i] = pend[i];
+      pend[i] = val;
+    }
+}
+
+// fills 'count' pixels with copies of the first one, doubling the number copied each time
+static void FillPixels(byte *ppixs, int count)
+{
+  for (int done = 1; done < count; )
+  {
+    int copy = ((count - done) < done) ? (count - done) : done;
+    memcpy((ppixs + (done * PIXEL_BYTES)), ppixs, (copy * PIXEL_BYTES));
+    done += copy;
+  }
+}
+
+// scales 'count' bytes by a fixed-point 'factor' (up to SCALE_FACTOR_ONE)
+#if HOST_BUILD
+typedef uint8_t  ByteVector __attribute__((vector_size(16)));
+typedef uint16_t WordVector __attribute__((vector_size(32)));
+
+static void ScaleBytes(byte *pbytes, int count, uint16_t factor)
+{
+  // 16 bytes at a time with SIMD instructions, using 16 bit intermediate values
+  for (; count >= (int)sizeof(ByteVector); count -= sizeof(ByteVector), pbytes += sizeof(ByteVector))
+  {
+    ByteVector bytes;
+    memcpy(&bytes, pbytes, sizeof(bytes));
+    WordVector words = (__builtin_convertvector(bytes, WordVector) * factor) >> 8;
+    bytes = __builtin_convertvector(words, ByteVector);
+    memcpy(pbytes, &bytes, sizeof(bytes));
+  }
+
+  for (; count > 0; --count, ++pbytes) *pbytes = (*pbytes * factor) >> 8;
+}
+#else
+static void ScaleBytes(byte *pbytes, int count, uint16_t factor)
+{
+  for (; count > 0; --count, ++pbytes) *pbytes = (*pbytes * factor) >> 8;
+}
+#endif
+
+// positions past the end wrap around to the start, so no pixels outside of the buffer are used
+inline byte *PixelNutSupport::PixelPtr(PixelNutHandle handle, uint16_t pos)
+{
+  PixelNutEngine::DrawContext *pc = (PixelNutEngine::DrawContext*)handle;
+  if (pos >= pc->pEngine->numPixels) pos %= pc->pEngine->numPixels;
+  uint32_t index = pos + pc->pTrack->pixOffset;
+  if (index >= pc->pEngine->numPixels) index -= pc->pEngine->numPixels;
+  return pc->pDrawPixels + (index * PIXEL_BYTES);
+}
+
+// callers limit the count to the number of pixels, so there's at most one more span after this
+inline byte *PixelNutSupport::SpanPtr(PixelNutHandle handle, uint16_t pos, uint16_t *pcount)
+{
+  PixelNutEngine::DrawContext *pc = (PixelNutEngine::DrawContext*)handle;
+  if (pos >= pc->pEngine->numPixels) pos %= pc->pEngine->numPixels;
+  uint32_t index = pos + pc->pTrack->pixOffset;
+  if (index >= pc->pEngine->numPixels) index -= pc->pEngine->numPixels;
+  if ((index + *pcount) > pc->pEngine->numPixels) *pcount = pc->pEngine->numPixels - index;
+  return pc->pDrawPixels + (index * PIXEL_BYTES);
+}
+
+// same as used by setPixel() with a scale of 1.0
+inline byte PixelNutSupport::BrightLevel(PixelNutHandle handle)
+{
+  PixelNutEngine::DrawContext *pc = (PixelNutEngine::DrawContext*)handle;
+  return GammaCorrection((pc->pEngine->getBrightPercent() * MAX_PIXEL_VALUE) / MAX_PERCENTAGE);
+}
+
+// rotates the pixels in place so that pixel 0 is at the start of the buffer again
+void PixelNutSupport::Unscroll(PixelNutHandle handle)
+{
+  PixelNutEngine::DrawContext *pc = (PixelNutEngine::DrawContext*)handle;
+  int offset = pc->pTrack->pixOffset;
+  int count = pc->pEngine->numPixels;
+
+  ReversePixels(pc->pDrawPixels, offset);
+  ReversePixels(pc->pDrawPixels + (offset * PIXEL_BYTES), (count - offset));
+  ReversePixels(pc->pDrawPixels, count);
+
+  pc->pTrack->pixOffset = 0;
+}
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 // Public interface routines
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 
-PixelNutSupport::PixelNutSupport(GetMsecsTime get_msecs, PixelValOrder *pix_order) // constructor
+PixelNutSupport::PixelNutSupport(GetMsecsTime get_msecs) // constructor
 {
-  pPixOrder = pix_order;  // sets ordering of pixel RGB
   getMsecs = get_msecs;   // sets routine to get time
   msgFormat = MsgFormat;  // default is no debug output
 }
@@ -118,69 +207,311 @@ void PixelNutSupport::makeColorVals(DrawProps *pdraw)
 {
   HSVtoRGB(pdraw->dvalueHue, (MAX_PERCENTAGE - pdraw->pcentWhite), pdraw->pcentBright,
             &pdraw->r, &pdraw->g, &pdraw->b);
+
+  pdraw->colorDirty = false;
+  pdraw->rgbHue    = pdraw->dvalueHue;
+  pdraw->rgbWhite  = pdraw->pcentWhite;
+  pdraw->rgbBright = pdraw->pcentBright;
+}
+
+void PixelNutSupport::updateColorVals(DrawProps *pdraw)
+{
+  if (!pdraw->colorDirty) return;
+
+  if ((pdraw->dvalueHue   != pdraw->rgbHue)   ||
+      (pdraw->pcentWhite  != pdraw->rgbWhite) ||
+      (pdraw->pcentBright != pdraw->rgbBright))
+       makeColorVals(pdraw);
+  else pdraw->colorDirty = false;
 }
 
 void PixelNutSupport::movePixels(PixelNutHandle handle, uint16_t startpos, uint16_t endpos, uint16_t newpos)
 {
-  PixelNutEngine *pEngine = (PixelNutEngine*)handle;
-  if (pEngine->pDrawPixels != NULL)
+  PixelNutEngine::DrawContext *pc = (PixelNutEngine::DrawContext*)handle;
+  if (pc->pDrawPixels != NULL)
   {
-    byte *ppixs1 = (pEngine->pDrawPixels + (startpos * 3));
-    byte *ppixs2 = (pEngine->pDrawPixels + (newpos * 3));
-    int count = (endpos - startpos + 1) * 3;
+    if (pc->pTrack->pixOffset) Unscroll(handle); // rarely used together
+
+    byte *ppixs1 = (pc->pDrawPixels + (startpos * PIXEL_BYTES));
+    byte *ppixs2 = (pc->pDrawPixels + (newpos * PIXEL_BYTES));
+    int count = (endpos - startpos + 1) * PIXEL_BYTES;
     memmove(ppixs2, ppixs1, count); 
   }
 }
 
 void PixelNutSupport::clearPixels(PixelNutHandle handle, uint16_t startpos, uint16_t endpos)
 {
-  PixelNutEngine *pEngine = (PixelNutEngine*)handle;
-  if (pEngine->pDrawPixels != NULL)
+  PixelNutEngine::DrawContext *pc = (PixelNutEngine::DrawContext*)handle;
+  if (pc->pDrawPixels != NULL)
   {
-    byte *ppixs = (pEngine->pDrawPixels + (startpos * 3));
-    int count = (endpos - startpos + 1) * 3;
-    memset(ppixs, 0, count);
+    int count = (endpos - startpos + 1);
+    if (count <= 0) return;
+    if (count > pc->pEngine->numPixels) count = pc->pEngine->numPixels;
+    if (startpos >= pc->pEngine->numPixels) startpos %= pc->pEngine->numPixels;
+
+    uint32_t index = startpos + pc->pTrack->pixOffset;
+    if (index >= pc->pEngine->numPixels) index -= pc->pEngine->numPixels;
+
+    int wrapped = (int)(index + count) - pc->pEngine->numPixels; // pixels past end of buffer
+    if (wrapped > 0)
+    {
+      memset(pc->pDrawPixels, 0, (wrapped * PIXEL_BYTES));
+      count -= wrapped;
+    }
+    memset((pc->pDrawPixels + (index * PIXEL_BYTES)), 0, (count * PIXEL_BYTES));
   }
 }
 
 void PixelNutSupport::getPixel(PixelNutHandle handle, uint16_t pos, byte *ptr_r, byte *ptr_g, byte *ptr_b)
 {
-  PixelNutEngine *pEngine = (PixelNutEngine*)handle;
-  if (pEngine->pDrawPixels != NULL)
+  PixelNutEngine::DrawContext *pc = (PixelNutEngine::DrawContext*)handle;
+  if (pc->pDrawPixels != NULL)
   {
-    byte *ppixs = (pEngine->pDrawPixels + (pos * 3));
-    *ptr_r = ppixs[pPixOrder->r];
-    *ptr_g = ppixs[pPixOrder->g];
-    *ptr_b = ppixs[pPixOrder->b];
+    byte *ppixs = PixelPtr(handle, pos);
+    PixelFormat::get(ppixs, ptr_r, ptr_g, ptr_b);
   }
 }
 
 void PixelNutSupport::setPixel(PixelNutHandle handle, uint16_t pos, byte r, byte g, byte b, float scale)
 {
-  PixelNutEngine *pEngine = (PixelNutEngine*)handle;
-  if (pEngine->pDrawPixels != NULL)
+  PixelNutEngine::DrawContext *pc = (PixelNutEngine::DrawContext*)handle;
+  if (pc->pDrawPixels != NULL)
   {
-    byte *ppixs = (pEngine->pDrawPixels + (pos * 3));
+    byte *ppixs = PixelPtr(handle, pos);
 
-    byte brightval = (scale * pEngine->getBrightPercent() * MAX_PIXEL_VALUE) / MAX_PERCENTAGE;
+    byte brightval = (scale * pc->pEngine->getBrightPercent() * MAX_PIXEL_VALUE) / MAX_PERCENTAGE;
     float factor = ((float)GammaCorrection(brightval) / MAX_PIXEL_VALUE);
 
-    ppixs[pPixOrder->r] = r * factor;
-    ppixs[pPixOrder->g] = g * factor;
-    ppixs[pPixOrder->b] = b * factor;
+    PixelFormat::put(ppixs, (r * factor), (g * factor), (b * factor));
   }
 }
 
 void PixelNutSupport::setPixel(PixelNutHandle handle, uint16_t pos, float scale)
 {
-  PixelNutEngine *pEngine = (PixelNutEngine*)handle;
-  if (pEngine->pDrawPixels != NULL)
+  PixelNutEngine::DrawContext *pc = (PixelNutEngine::DrawContext*)handle;
+  if (pc->pDrawPixels != NULL)
+  {
+    byte *ppixs = PixelPtr(handle, pos);
+
+    for (int i = 0; i < PIXEL_BYTES; ++i) ppixs[i] *= scale;
+  }
+}
+
+void PixelNutSupport::fillPixels(PixelNutHandle handle, uint16_t pos, uint16_t count, byte r, byte g, byte b)
+{
+  PixelNutEngine::DrawContext *pc = (PixelNutEngine::DrawContext*)handle;
+  if (pc->pDrawPixels != NULL)
+  {
+    if (count > pc->pEngine->numPixels) count = pc->pEngine->numPixels;
+
+    float factor = ((float)BrightLevel(handle) / MAX_PIXEL_VALUE);
+    byte pixel[PIXEL_BYTES];
+    PixelFormat::put(pixel, (r * factor), (g * factor), (b * factor));
+
+    while (count > 0) // at most twice: before and after the buffer wraps around
+    {
+      uint16_t run = count;
+      byte *ppixs = SpanPtr(handle, pos, &run);
+      memcpy(ppixs, pixel, PIXEL_BYTES);
+      FillPixels(ppixs, run);
+      pos += run;
+      count -= run;
+    }
+  }
+}
+
+void PixelNutSupport::scalePixels(PixelNutHandle handle, uint16_t pos, uint16_t count, uint16_t factor)
+{
+  PixelNutEngine::DrawContext *pc = (PixelNutEngine::DrawContext*)handle;
+  if (pc->pDrawPixels != NULL)
+  {
+    if (count > pc->pEngine->numPixels) count = pc->pEngine->numPixels;
+
+    if (factor > SCALE_FACTOR_ONE) factor = SCALE_FACTOR_ONE;
+
+    while (count > 0)
+    {
+      uint16_t run = count;
+      byte *ppixs = SpanPtr(handle, pos, &run);
+      ScaleBytes(ppixs, (run * PIXEL_BYTES), factor);
+      pos += run;
+      count -= run;
+    }
+  }
+}
+
+void PixelNutSupport::setDecay(PixelNutHandle handle, uint16_t factor)
+{
+  PixelNutEngine::DrawContext *pc = (PixelNutEngine::DrawContext*)handle;
+  if (pc->pDrawPixels != NULL)
+    pc->pTrack->decayFactor = (factor < SCALE_FACTOR_ONE) ? factor : 0;
+}
+
+void PixelNutSupport::setIdle(PixelNutHandle handle)
+{
+  PixelNutEngine::DrawContext *pc = (PixelNutEngine::DrawContext*)handle;
+  if (pc->pLayer != NULL) pc->pLayer->idle = true;
+}
+
+void PixelNutSupport::gradientPixels(PixelNutHandle handle, uint16_t pos, uint16_t count,
+                                     byte r1, byte g1, byte b1, byte r2, byte g2, byte b2)
+{
+  PixelNutEngine::DrawContext *pc = (PixelNutEngine::DrawContext*)handle;
+  if ((pc->pDrawPixels != NULL) && (count > 0))
+  {
+    if (count > pc->pEngine->numPixels) count = pc->pEngine->numPixels;
+
+    float factor = ((float)BrightLevel(handle) / MAX_PIXEL_VALUE);
+
+    // colors in 16.16 fixed-point, stepped so that the last pixel has the second color
+    int32_t r = (int32_t)(byte)(r1 * factor) << 16;
+    int32_t g = (int32_t)(byte)(g1 * factor) << 16;
+    int32_t b = (int32_t)(byte)(b1 * factor) << 16;
+    int32_t steps = (count > 1) ? (count - 1) : 1;
+    int32_t rstep = (((int32_t)(byte)(r2 * factor) << 16) - r) / steps;
+    int32_t gstep = (((int32_t)(byte)(g2 * factor) << 16) - g) / steps;
+    int32_t bstep = (((int32_t)(byte)(b2 * factor) << 16) - b) / steps;
+
+    // round to nearest value
+    r += 0x8000; g += 0x8000; b += 0x8000;
+
+    while (count > 0)
+    {
+      uint16_t run = count;
+      byte *ppixs = SpanPtr(handle, pos, &run);
+      pos += run;
+      count -= run;
+
+      for (; run > 0; --run, ppixs += PIXEL_BYTES)
+      {
+        PixelFormat::put(ppixs, (r >> 16), (g >> 16), (b >> 16));
+        r += rstep; g += gstep; b += bstep;
+      }
+    }
+  }
+}
+
+void PixelNutSupport::copyPixels(PixelNutHandle handle, uint16_t pos, uint16_t count, const byte *prgb)
+{
+  PixelNutEngine::DrawContext *pc = (PixelNutEngine::DrawContext*)handle;
+  if (pc->pDrawPixels != NULL)
+  {
+    if (count > pc->pEngine->numPixels) count = pc->pEngine->numPixels;
+
+    // same as (level / MAX_PIXEL_VALUE) used by setPixel(), but in fixed-point
+    uint16_t factor = ((BrightLevel(handle) * SCALE_FACTOR_ONE) + (MAX_PIXEL_VALUE/2)) / MAX_PIXEL_VALUE;
+
+    while (count > 0)
+    {
+      uint16_t run = count;
+      byte *ppixs = SpanPtr(handle, pos, &run);
+      pos += run;
+      count -= run;
+
+      byte *pstart = ppixs;
+      for (int i = 0; i < run; ++i, ppixs += PIXEL_BYTES, prgb += 3)
+        PixelFormat::put(ppixs, prgb[0], prgb[1], prgb[2]);
+
+      if (factor < SCALE_FACTOR_ONE) ScaleBytes(pstart, (run * PIXEL_BYTES), factor);
+    }
+  }
+}
+
+uint16_t PixelNutSupport::layoutWidth(PixelNutHandle handle)
+{
+  return ((PixelNutEngine::DrawContext*)handle)->pEngine->layoutWidth;
+}
+
+uint16_t PixelNutSupport::layoutHeight(PixelNutHandle handle)
+{
+  return ((PixelNutEngine::DrawContext*)handle)->pEngine->layoutHeight;
+}
+
+uint16_t PixelNutSupport::layoutIndex(PixelNutHandle handle, uint16_t x, uint16_t y)
+{
+  PixelNutEngine *pEngine = ((PixelNutEngine::DrawContext*)handle)->pEngine;
+  if ((x >= pEngine->layoutWidth) || (y >= pEngine->layoutHeight)) return LAYOUT_NO_PIXEL;
+  if (pEngine->pLayoutIndexes == NULL) return x; // single row
+
+  return pEngine->pLayoutIndexes[(y * pEngine->layoutWidth) + x];
+}
+
+const PixelNutSupport::LayoutSpan *PixelNutSupport::layoutRow(PixelNutHandle handle, uint16_t y, uint16_t *pcount)
+{
+  PixelNutEngine *pEngine = ((PixelNutEngine::DrawContext*)handle)->pEngine;
+  *pcount = 0;
+  if (y >= pEngine->layoutHeight) return NULL;
+
+  if (pEngine->pLayoutSpans == NULL) // single row
+  {
+    *pcount = 1;
+    return &pEngine->lineSpan;
+  }
+
+  *pcount = pEngine->pLayoutRows[y+1] - pEngine->pLayoutRows[y];
+  return pEngine->pLayoutSpans + pEngine->pLayoutRows[y];
+}
+
+void PixelNutSupport::copyRowPixels(PixelNutHandle handle, uint16_t y, uint16_t x, uint16_t count, const byte *prgb)
+{
+  PixelNutEngine::DrawContext *pc = (PixelNutEngine::DrawContext*)handle;
+  if (pc->pDrawPixels != NULL)
+  {
+    uint16_t factor = 0;
+    uint16_t nspans;
+    const LayoutSpan *pspan = layoutRow(handle, y, &nspans);
+
+    for (; nspans > 0; --nspans, ++pspan) // the part of each span within the columns
+    {
+      int first = (pspan->x > x) ? pspan->x : x;
+      int last = ((pspan->x + pspan->count) < (x + count)) ? (pspan->x + pspan->count) : (x + count);
+      if (first >= last) continue;
+
+      uint16_t pos = pspan->pos + ((first - pspan->x) * pspan->step);
+      const byte *psrc = prgb + ((first - x) * 3);
+
+      if (pspan->step == 1) // contiguous pixels
+      {
+        copyPixels(handle, pos, (last - first), psrc);
+        continue;
+      }
+
+      // same as copyPixels(), but stepping through the pixels (as they wrap around if scrolled)
+      if (factor == 0)
+        factor = ((BrightLevel(handle) * SCALE_FACTOR_ONE) + (MAX_PIXEL_VALUE/2)) / MAX_PIXEL_VALUE;
+
+      for (int i = first; i < last; ++i, pos += pspan->step, psrc += 3)
+      {
+        byte *ppixs = PixelPtr(handle, pos);
+        PixelFormat::put(ppixs, psrc[0], psrc[1], psrc[2]);
+        if (factor < SCALE_FACTOR_ONE) ScaleBytes(ppixs, PIXEL_BYTES, factor);
+      }
+    }
+  }
+}
+
+byte PixelNutSupport::gammaCorrect(byte value) { return GammaCorrection(value); }
+
+void PixelNutSupport::scrollPixels(PixelNutHandle handle, int count)
+{
+  PixelNutEngine::DrawContext *pc = (PixelNutEngine::DrawContext*)handle;
+  if (pc->pDrawPixels != NULL)
   {
-    byte *ppixs = (pEngine->pDrawPixels + (pos * 3));
+    int npixels = pc->pEngine->numPixels;
+    if ((count >= npixels) || (count <= -npixels))
+    {
+      clearPixels(handle, 0, (npixels-1));
+      return;
+    }
+
+    int offset = pc->pTrack->pixOffset - count;
+    if (offset < 0) offset += npixels;
+    else if (offset >= npixels) offset -= npixels;
+    pc->pTrack->pixOffset = offset;
 
-    ppixs[pPixOrder->r] *= scale;
-    ppixs[pPixOrder->g] *= scale;
-    ppixs[pPixOrder->b] *= scale;
+    // clear the pixels scrolled off one end, now at the other
+    if (count > 0) clearPixels(handle, 0, (count-1));
+    else if (count < 0) clearPixels(handle, (npixels + count), (npixels-1));
   }
 }
 
@@ -200,6 +531,6 @@ long PixelNutSupport::clipValue(long inval, long out_min, long out_max)
 
 void PixelNutSupport::sendForce(PixelNutHandle handle, uint16_t id, byte force)
 {
-  PixelNutEngine *pEngine = (PixelNutEngine*)handle;
-  pEngine->triggerForce(id, force);
+  PixelNutEngine::DrawContext *pc = (PixelNutEngine::DrawContext*)handle;
+  pc->pEngine->SendForce(pc, id, force);
 }
@@ -27,19 +27,66 @@ typedef void* PixelNutHandle;   // context to call methods with
 
 typedef uint32_t (*GetMsecsTime)(void);
 
-typedef struct // defines ordering of RGB pixel values
+typedef struct // defines ordering of RGB pixel values (only used by the old constructor)
 {
   byte r,g,b;
 }
 PixelValOrder;
 
+// Pixel formats: the offset of each color within the bytes of a pixel as they are sent to
+// the strand, and the offset of the white channel for RGBW strands (such as the SK6812), into
+// which the white common to all three colors is moved when a pixel is set. The format for the
+// build is chosen with PIXEL_FORMAT, so that all pixel handling is specialized for it.
+#define PIXEL_NO_WHITE  0xFF
+
+template <byte R, byte G, byte B, byte W=PIXEL_NO_WHITE>
+struct PixelFormatOf
+{
+  enum { bytes = ((W == PIXEL_NO_WHITE) ? 3 : 4) }; // bytes for each pixel
+
+  static inline void put(byte *ppix, byte r, byte g, byte b)
+  {
+    if (W != PIXEL_NO_WHITE)
+    {
+      byte w = (r < g) ? r : g;
+      if (b < w) w = b;
+      ppix[W & 3] = w;
+      r -= w; g -= w; b -= w;
+    }
+    ppix[R] = r; ppix[G] = g; ppix[B] = b;
+  }
+
+  static inline void get(const byte *ppix, byte *pr, byte *pg, byte *pb)
+  {
+    if (W != PIXEL_NO_WHITE)
+    {
+      int w = ppix[W & 3];
+      *pr = ((ppix[R] + w) < MAX_PIXEL_VALUE) ? (ppix[R] + w) : MAX_PIXEL_VALUE;
+      *pg = ((ppix[G] + w) < MAX_PIXEL_VALUE) ? (ppix[G] + w) : MAX_PIXEL_VALUE;
+      *pb = ((ppix[B] + w) < MAX_PIXEL_VALUE) ? (ppix[B] + w) : MAX_PIXEL_VALUE;
+    }
+    else { *pr = ppix[R]; *pg = ppix[G]; *pb = ppix[B]; }
+  }
+};
+
+typedef PixelFormatOf<0,1,2>   PixelFormat_RGB;
+typedef PixelFormatOf<1,0,2>   PixelFormat_GRB;
+typedef PixelFormatOf<2,1,0>   PixelFormat_BGR;
+typedef PixelFormatOf<0,1,2,3> PixelFormat_RGBW;
+typedef PixelFormatOf<1,0,2,3> PixelFormat_GRBW;
+
+typedef PIXEL_FORMAT PixelFormat;           // format used for all pixels
+#define PIXEL_BYTES     PixelFormat::bytes  // number of bytes for each pixel
+
 class PixelNutSupport // Support definitions and services for PixelNut engine and applications
 {
 public:
-  // 'pix_array' is array of 3 bytes: index of Red, Green, Blue pixels
-  // WS2812B pixels are ordered GRB: array = [1,0,2]
-  // APA102 pixels are ordered BGR, array [2,1,0]
-  PixelNutSupport(GetMsecsTime get_msecs, PixelValOrder *pix_order); // constructor
+  // the ordering of the pixel colors is set at compile time with PIXEL_FORMAT
+  PixelNutSupport(GetMsecsTime get_msecs); // constructor
+
+  // kept for existing applications: the 'pix_order' is ignored, and must be the same as
+  // the PIXEL_FORMAT the build uses (WS2812B [1,0,2] is the default, APA102 [2,1,0])
+  PixelNutSupport(GetMsecsTime get_msecs, PixelValOrder *pix_order) : PixelNutSupport(get_msecs) {}
 
   /////////////////////////////////////////////////////////////////////////////
   // Optionally set from the main application; used by the PixelNut Engine.
@@ -56,7 +103,7 @@ public:
   // and the Plugins to draw into pixel buffers and handle trigger events.
 
   // properties that can be modified at any time by commands/plugins:
-  typedef struct ATTR_PACKED // 18 bytes
+  typedef struct ATTR_PACKED // 22 bytes
   {
     uint16_t pixStart;          // start of pixel draw range (from 0)
     uint16_t pixLen;            // length of pixels to drawn (1-max)
@@ -72,10 +119,18 @@ public:
     bool pixOrValues;           // whether pixels overwrite or are combined
     bool noRepeating;           // true for one-shot, else continuous
 
-    uint8_t filler;
+    bool colorDirty;            // set by colorChanged(): r,g,b may need recalculating
+    uint16_t rgbHue;            // (hue,white,bright) that r,g,b were last calculated from
+    byte rgbWhite, rgbBright;
   }
   DrawProps; // defines properties used in drawing an effect
 
+  // Called after changing the hue/white/bright properties: r,g,b are recalculated only once
+  // before the drawing plugin's next step, however many times this is called, and only if
+  // the values are then different. Use makeColorVals() if r,g,b are needed right away.
+  void colorChanged(DrawProps *pdraw) { pdraw->colorDirty = true; }
+  void updateColorVals(DrawProps *pdraw); // used by the engine to do that recalculation
+
   void makeColorVals(DrawProps *pdraw); // performs translation of hue/white/bright to RGB pixel values
 
   // abstracts plugins from the direct handling of the pixel values:
@@ -85,12 +140,65 @@ public:
   void setPixel(   PixelNutHandle p, uint16_t pos, byte r, byte g, byte b, float scale=1.0);  // sets RGB pixel values
   void setPixel(   PixelNutHandle p, uint16_t pos, float scale); // scales existing value without applying gamma correction
 
+  // Span versions of the above for 'count' pixels starting at 'pos', which are much faster than
+  // setting each pixel separately. Colors have the brightness applied as with setPixel(), and
+  // fixed-point factors are 8.8 bits: SCALE_FACTOR_ONE leaves values unchanged, half that halves them.
+  #define SCALE_FACTOR_ONE  256
+  #define SPAN_CHUNK_PIXELS 32      // pixels plugins compose on the stack before copying
+  void fillPixels(    PixelNutHandle p, uint16_t pos, uint16_t count, byte r, byte g, byte b); // sets all to one color
+  void scalePixels(   PixelNutHandle p, uint16_t pos, uint16_t count, uint16_t factor);        // scales (fades) existing values
+  void gradientPixels(PixelNutHandle p, uint16_t pos, uint16_t count, byte r1, byte g1, byte b1,
+                                                                      byte r2, byte g2, byte b2); // blends first to last color
+  void copyPixels(    PixelNutHandle p, uint16_t pos, uint16_t count, const byte *prgb);       // sets from R,G,B byte triplets
+
+  // Pixels laid out in 2 dimensions (see PixelLayout), or else all of them in a single row.
+  // Each row is made up of spans: 'count' pixels from column 'x', the first at 'pos' and
+  // each one after that 'step' pixels further on (-1 if the row runs backwards).
+  typedef struct
+  {
+    uint16_t x;                 // first column of the span
+    uint16_t pos;               // pixel at that column
+    uint16_t count;             // columns in the span
+    int16_t step;               // from the pixel of one column to the next
+  }
+  LayoutSpan;
+  uint16_t layoutWidth( PixelNutHandle p);                                    // columns in each row
+  uint16_t layoutHeight(PixelNutHandle p);                                    // number of rows
+  uint16_t layoutIndex( PixelNutHandle p, uint16_t x, uint16_t y);            // pixel at x,y or LAYOUT_NO_PIXEL
+  const LayoutSpan *layoutRow(PixelNutHandle p, uint16_t y, uint16_t *pcount); // spans that make up row 'y'
+  void copyRowPixels(PixelNutHandle p, uint16_t y, uint16_t x, uint16_t count, const byte *prgb); // sets
+                                                    // 'count' pixels of row 'y' from column 'x' as copyPixels()
+
+  // Puts the track into decay mode: before each step the engine scales its whole buffer by the
+  // fixed-point 'factor', so a plugin need only draw what is new and leave the rest to fade.
+  // Using SCALE_FACTOR_ONE (or 0) turns this off, as does switching to another plugin.
+  void setDecay(PixelNutHandle p, uint16_t factor);
+
+  // Called from nextstep() when a plugin has nothing more to do until its properties change or
+  // it's triggered, so that it isn't stepped again until then (nor its track redrawn if it draws).
+  void setIdle(PixelNutHandle p);
+
+  // returns gamma corrected value, for plugins scaling the levels of pixels they copy
+  byte gammaCorrect(byte value);
+
+  // Scrolls the track's pixels 'count' positions towards the end (or the start if negative),
+  // by rotating where the buffer starts instead of moving them. Pixels scrolled off one end
+  // are cleared, and the ones exposed at the other end are left for the plugin to draw.
+  void scrollPixels(PixelNutHandle p, int count);
+
   // utility functions to map and clip values into/over a range of values
   long mapValue(long inval, long in_min, long in_max, long out_min, long out_max);
   long clipValue(long inval, long out_min, long out_max);
 
   // sends trigger force to any other effect that has been assigned to this 'id'
+  // (when rendering tracks in parallel this is done after all tracks are drawn)
   void sendForce(PixelNutHandle p, uint16_t id, byte force);
+
+private:
+  byte *PixelPtr(PixelNutHandle p, uint16_t pos); // where a pixel is after any scrolling
+  byte *SpanPtr(PixelNutHandle p, uint16_t pos, uint16_t *pcount); // and a span up to where it wraps
+  byte BrightLevel(PixelNutHandle p);             // gamma corrected engine brightness level
+  void Unscroll(PixelNutHandle p);                // moves pixels to undo any scrolling
 };
 
 extern PixelNutSupport pixelNutSupport; // single statically allocated instance
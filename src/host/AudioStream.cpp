@@ -0,0 +1,220 @@
+// Host Audio Stream Class Implementation
+/*
+    Copyright (c) 2021, Greg de Valois
+    Software License Agreement (MIT License)
+    See license.txt for the terms of this license.
+*/
+
+#include "core.h"
+#include "host/AudioStream.h"
+
+#if HOST_BUILD && FREQ_FFT
+
+#include <time.h>
+
+#define WAV_FORMAT_PCM          1
+#define WAV_FORMAT_EXTENSIBLE   0xFFFE
+#define WAV_MAX_CHANNELS        8
+
+static uint64_t NowNsecs(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t)ts.tv_sec * 1000000000) + ts.tv_nsec;
+}
+
+static uint16_t LittleEndian16(const byte *p) { return p[0] | (p[1] << 8); }
+static uint32_t LittleEndian32(const byte *p) { return LittleEndian16(p) | ((uint32_t)LittleEndian16(p+2) << 16); }
+
+AudioStream::AudioStream(const char *path, bool realtime, int rawrate)
+{
+  pathName = path;
+  realTime = realtime;
+  rawRate = rawrate;
+  fin = NULL;
+  atEnd = true;
+  inRate = 0;
+}
+
+bool AudioStream::begin(int rate)
+{
+  if (strcmp(pathName, "-") == 0) fin = stdin;
+  else if ((fin = fopen(pathName, "rb")) == NULL)
+  {
+    fprintf(stderr, "Cannot open audio: %s\n", pathName);
+    return false;
+  }
+
+  outRate = rate;
+  headLen = headPos = 0;
+
+  if (!ReadHeader())
+  {
+    end();
+    return false;
+  }
+
+  phase = 0;
+  sumValues = 0;
+  sumCount = 0;
+  lastValue = 0;
+  samplesInput = 0;
+  samplesOutput = 0;
+  nsecsStart = NowNsecs();
+  atEnd = false;
+  return true;
+}
+
+void AudioStream::end(void)
+{
+  if ((fin != NULL) && (fin != stdin)) fclose(fin);
+  fin = NULL;
+  atEnd = true;
+}
+
+// reads from the bytes already read looking for a header, then from the stream
+bool AudioStream::ReadBytes(byte *pbytes, uint32_t count)
+{
+  while ((count > 0) && (headPos < headLen))
+  {
+    *pbytes++ = headBytes[headPos++];
+    --count;
+  }
+
+  return ((count == 0) || (fread(pbytes, 1, count, fin) == count));
+}
+
+// reads the header of a WAV file up to the start of the data, else sets up for raw PCM
+bool AudioStream::ReadHeader(void)
+{
+  byte chunk[40];
+
+  headLen = fread(headBytes, 1, sizeof(headBytes), fin);
+  if ((headLen < 12) || memcmp(headBytes, "RIFF", 4) || memcmp(headBytes+8, "WAVE", 4))
+  {
+    inRate = (rawRate > 0) ? rawRate : outRate;
+    inChannels = 1;
+    dataLeft = UINT32_MAX;
+    return true;
+  }
+
+  headPos = headLen; // consumed by the header
+  inRate = 0;
+
+  while (true)
+  {
+    if (fread(chunk, 1, 8, fin) != 8) break;
+    uint32_t size = LittleEndian32(chunk+4);
+
+    if (!memcmp(chunk, "data", 4))
+    {
+      if (inRate == 0) break; // format must come first
+
+      dataLeft = size;
+      return true;
+    }
+
+    if (!memcmp(chunk, "fmt ", 4) && (size >= 16) && (size <= sizeof(chunk)))
+    {
+      if (fread(chunk, 1, size, fin) != size) break;
+
+      int format = LittleEndian16(chunk);
+      int bits = LittleEndian16(chunk+14);
+      inChannels = LittleEndian16(chunk+2);
+      inRate = LittleEndian32(chunk+4);
+
+      if (((format != WAV_FORMAT_PCM) && (format != WAV_FORMAT_EXTENSIBLE)) || (bits != 16) ||
+          (inChannels < 1) || (inChannels > WAV_MAX_CHANNELS) || (inRate <= 0))
+      {
+        fprintf(stderr, "Audio must be 16-bit PCM: format=%d bits=%d channels=%d\n",
+                        format, bits, inChannels);
+        return false;
+      }
+
+      if (size & 1) fgetc(fin); // chunks are padded to even sizes
+    }
+    else // skip over chunk (can't seek on pipes)
+    {
+      for (uint32_t i = 0; i < size + (size & 1); ++i)
+        if (fgetc(fin) == EOF) break;
+    }
+  }
+
+  fprintf(stderr, "Invalid WAV file: %s\n", pathName);
+  return false;
+}
+
+bool AudioStream::ReadSample(int16_t *pvalue)
+{
+  byte bytes[2 * WAV_MAX_CHANNELS];
+  uint32_t count = 2 * inChannels;
+
+  if ((dataLeft < count) || !ReadBytes(bytes, count)) return false;
+  if (dataLeft != UINT32_MAX) dataLeft -= count;
+
+  int32_t value = 0;
+  for (int i = 0; i < inChannels; ++i)
+    value += (int16_t)LittleEndian16(bytes + (2 * i));
+
+  *pvalue = value / inChannels;
+  ++samplesInput;
+  return true;
+}
+
+// averages the input samples for each output one (repeating them if the input rate is lower)
+bool AudioStream::NextSample(int16_t *pvalue)
+{
+  while (phase < (uint32_t)inRate)
+  {
+    int16_t value;
+    if (!ReadSample(&value)) return false;
+
+    sumValues += value;
+    ++sumCount;
+    phase += outRate;
+  }
+  phase -= inRate;
+
+  if (sumCount > 0)
+  {
+    lastValue = sumValues / sumCount;
+    sumValues = 0;
+    sumCount = 0;
+  }
+
+  *pvalue = lastValue;
+  return true;
+}
+
+const int16_t *AudioStream::next(void)
+{
+  uint64_t count;
+  if (realTime)
+       count = (((NowNsecs() - nsecsStart) * outRate) / 1000000000) - samplesOutput;
+  else count = fillSpace();
+
+  while ((count > 0) && !atEnd)
+  {
+    int16_t *psample = fillPtr();
+    int space = fillSpace();
+    if (count < (uint64_t)space) space = count;
+
+    int i = 0;
+    for (; i < space; ++i)
+    {
+      if (!NextSample(psample + i))
+      {
+        atEnd = true;
+        break;
+      }
+    }
+
+    filled(i);
+    samplesOutput += i;
+    count -= i;
+  }
+
+  return takeReady();
+}
+
+#endif // HOST_BUILD && FREQ_FFT
@@ -0,0 +1,63 @@
+// Host Audio Stream Class Definition
+// Audio source that reads recorded audio from a file or pipe.
+/*
+    Copyright (c) 2021, Greg de Valois
+    Software License Agreement (MIT License)
+    See license.txt for the terms of this license.
+*/
+
+#pragma once
+
+#if HOST_BUILD && FREQ_FFT
+
+#include "xplugins/audioin.h"
+
+// Reads a WAV file (16-bit PCM, any number of channels, which are mixed together) or else
+// raw 16-bit mono PCM (little endian), from a file or from standard input ("-"). Samples
+// are averaged (or repeated) to get the rate asked for. In real time they are read as the
+// time passes, else each request for the next block reads exactly one block, so streams
+// can be analyzed as fast as possible.
+
+class AudioStream : public AudioSource
+{
+public:
+  // 'rawrate' is the sample rate of raw PCM, or 0 if the same as asked for by begin()
+  AudioStream(const char *path, bool realtime, int rawrate=0);
+
+  bool begin(int rate);
+  void end(void);
+  const int16_t *next(void);
+  bool ended(void) { return atEnd; }
+
+  int inputRate(void) { return inRate; }    // sample rate of the stream
+  uint64_t samplesInput;                    // number of samples read from the stream
+
+private:
+  const char *pathName;
+  bool realTime;
+  int rawRate;
+
+  FILE *fin;
+  bool atEnd;
+  int inRate, outRate;
+  int inChannels;
+  uint32_t dataLeft;                        // bytes left in the WAV data chunk
+
+  byte headBytes[12];                       // start of raw PCM, read looking for a header
+  int headLen, headPos;
+
+  uint32_t phase;                           // of the input samples to the output ones
+  int32_t sumValues;                        // input samples averaged into the next output
+  int sumCount;
+  int16_t lastValue;
+
+  uint64_t nsecsStart;
+  uint64_t samplesOutput;
+
+  bool ReadBytes(byte *pbytes, uint32_t count);
+  bool ReadHeader(void);
+  bool ReadSample(int16_t *pvalue);         // next input sample, false if none left
+  bool NextSample(int16_t *pvalue);         // next output sample, false if none left
+};
+
+#endif // HOST_BUILD && FREQ_FFT
@@ -0,0 +1,67 @@
+// Host Arduino Routines
+/*
+    Copyright (c) 2021, Greg de Valois
+    Software License Agreement (MIT License)
+    See license.txt for the terms of this license.
+*/
+
+#include "host/HostArduino.h"
+
+#if !defined(ARDUINO)
+
+#include <time.h>
+#include <unistd.h>
+
+static thread_local uint32_t randomState = 1;
+
+// xorshift: fast, and good enough for effects
+static uint32_t RandomNext(void)
+{
+  uint32_t x = randomState;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  return (randomState = x);
+}
+
+uint32_t randomSwapState(uint32_t state)
+{
+  if (state == 0) return 0; // keep the one in use
+  uint32_t prev = randomState;
+  randomState = state;
+  return prev;
+}
+
+long random(long howbig)
+{
+  if (howbig <= 0) return 0;
+  return RandomNext() % (uint32_t)howbig;
+}
+
+long random(long howsmall, long howbig)
+{
+  if (howsmall >= howbig) return howsmall;
+  return howsmall + random(howbig - howsmall);
+}
+
+void randomSeed(unsigned long seed)
+{
+  if (seed != 0) randomState = (uint32_t)seed;
+}
+
+static uint64_t NowUsecs(void)
+{
+  static uint64_t start = 0;
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  uint64_t usecs = ((uint64_t)ts.tv_sec * 1000000) + (ts.tv_nsec / 1000);
+  if (start == 0) start = usecs;
+  return usecs - start;
+}
+
+unsigned long millis(void) { return NowUsecs() / 1000; }
+unsigned long micros(void) { return NowUsecs(); }
+void delay(unsigned long msecs) { usleep(msecs * 1000); }
+
+#endif // !ARDUINO
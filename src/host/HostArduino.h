@@ -0,0 +1,41 @@
+// Host Arduino Definitions
+// Native stand-in for <Arduino.h>, with just what the engine and plugins use.
+/*
+    Copyright (c) 2021, Greg de Valois
+    Software License Agreement (MIT License)
+    See license.txt for the terms of this license.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <ctype.h>
+#include <string.h>
+#include <math.h>
+
+typedef uint8_t byte;
+
+// program memory is the same as any other
+#define F(x)                    x
+#define PROGMEM
+#define pgm_read_byte(p)        (*(const uint8_t*)(p))
+#define pgm_read_word(p)        (*(const uint16_t*)(p))
+#define pgm_read_dword(p)       (*(const uint32_t*)(p))
+#define strcpy_P                strcpy
+#define memcpy_P                memcpy
+
+// Each thread has its own random sequence, so that engines updated on many threads
+// don't share (and race on) the state. Which thread updates an engine (or renders one
+// of its tracks) changes from run to run, so engines swap in the state of each track
+// with randomSwapState() while it's drawn or triggered, keeping the effects repeatable.
+extern long random(long howbig);            // 0...howbig-1
+extern long random(long howsmall, long howbig); // howsmall...howbig-1
+extern void randomSeed(unsigned long seed);
+extern uint32_t randomSwapState(uint32_t state); // returns previous; 0 keeps it (and returns 0)
+
+extern unsigned long millis(void);
+extern unsigned long micros(void);
+extern void delay(unsigned long msecs);
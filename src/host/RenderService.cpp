@@ -0,0 +1,246 @@
+// Host Render Service Class Implementation
+/*
+    Copyright (c) 2021, Greg de Valois
+    Software License Agreement (MIT License)
+    See license.txt for the terms of this license.
+*/
+
+#include "core.h"
+#include "host/RenderService.h"
+
+#if HOST_BUILD
+
+#include <pthread.h>
+#include <time.h>
+
+static uint32_t frameClock = 0; // time of current frame in msecs
+
+typedef struct
+{
+  RenderService *pService;
+  int thread;
+}
+ThreadArgs;
+
+static uint64_t NowNsecs(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t)ts.tv_sec * 1000000000) + ts.tv_nsec;
+}
+
+// returns histogram bucket for a time: RENDER_HIST_STEPS buckets for each power of 2
+static int HistBucket(uint32_t nsecs)
+{
+  if (nsecs < RENDER_HIST_STEPS) return nsecs;
+
+  int msb = 31 - __builtin_clz(nsecs);
+  int step = (nsecs >> (msb - RENDER_HIST_BITS)) & (RENDER_HIST_STEPS-1);
+  return ((msb - RENDER_HIST_BITS + 1) * RENDER_HIST_STEPS) + step;
+}
+
+// returns the largest time that falls into a histogram bucket
+static uint64_t HistNsecs(int bucket)
+{
+  if (bucket < RENDER_HIST_STEPS) return bucket;
+
+  int msb = (bucket / RENDER_HIST_STEPS) + RENDER_HIST_BITS - 1;
+  int step = bucket % RENDER_HIST_STEPS;
+  return ((uint64_t)(RENDER_HIST_STEPS + step + 1) << (msb - RENDER_HIST_BITS)) - 1;
+}
+
+// returns the usecs at or below which 'pcent' percent of the counts are (at most 'nsecsmax')
+static double HistPercentile(uint32_t *histogram, double pcent, uint32_t nsecsmax)
+{
+  uint64_t total = 0;
+  for (int i = 0; i < RENDER_HIST_BUCKETS; ++i) total += histogram[i];
+  if (total == 0) return 0;
+
+  uint64_t limit = (uint64_t)((total * pcent) / 100);
+  if (limit < 1) limit = 1;
+
+  uint64_t count = 0;
+  int i;
+  for (i = 0; i < (RENDER_HIST_BUCKETS-1); ++i)
+  {
+    count += histogram[i];
+    if (count >= limit) break;
+  }
+  return ((HistNsecs(i) < nsecsmax) ? HistNsecs(i) : nsecsmax) / 1000.0;
+}
+
+static void *ThreadMain(void *param)
+{
+  ThreadArgs args = *(ThreadArgs*)param;
+  free(param); // only needed to start
+  args.pService->RunThread(args.thread);
+  return NULL;
+}
+
+uint32_t RenderService::frameMsecs(void) { return frameClock; }
+
+bool RenderService::begin(int count, uint16_t pixels, int threads, const PixelLayout *layout)
+{
+  if (threads < 1) threads = 1;
+  if (threads > count) threads = count;
+
+  numEngines = count;
+  numThreads = threads;
+  nsecsRunning = countFrames = 0;
+  nsecsFrameMax = 0;
+  memset(frameHistogram, 0, sizeof(frameHistogram));
+
+  pEngines = new PixelNutEngine[count];
+  pStats   = (FrameStats*)calloc(count, sizeof(FrameStats));
+  pRanges  = (WorkRange*)aligned_alloc(64, threads * sizeof(WorkRange));
+  pBarrier = malloc(sizeof(pthread_barrier_t));
+  if ((pEngines == NULL) || (pStats == NULL) || (pRanges == NULL) || (pBarrier == NULL))
+    return false;
+
+  for (int i = 0; i < count; ++i)
+    if (!pEngines[i].init(pixels, PIXEL_BYTES, NUM_PLUGIN_LAYERS, NUM_PLUGIN_TRACKS, 0, false, layout))
+    {
+      DBGOUT((F("Failed to initialize engine %d"), i));
+      return false;
+    }
+
+  if (pthread_barrier_init((pthread_barrier_t*)pBarrier, NULL, threads) != 0)
+    return false;
+
+  // calling thread is the first one, so create the others
+  for (int i = 1; i < threads; ++i)
+  {
+    ThreadArgs *pargs = (ThreadArgs*)malloc(sizeof(ThreadArgs));
+    if (pargs == NULL) return false;
+    pargs->pService = this;
+    pargs->thread = i;
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, ThreadMain, pargs) != 0)
+    {
+      free(pargs);
+      return false;
+    }
+    pthread_detach(thread);
+  }
+
+  return true;
+}
+
+void RenderService::RunThread(int thread)
+{
+  while (true)
+  {
+    pthread_barrier_wait((pthread_barrier_t*)pBarrier); // wait for start of frame
+    RenderAll(thread);
+    pthread_barrier_wait((pthread_barrier_t*)pBarrier); // signal end of frame
+  }
+}
+
+// renders the thread's own range of engines first, then helps the other threads
+void RenderService::RenderAll(int thread)
+{
+  for (int i = 0; i < numThreads; ++i)
+  {
+    WorkRange *pr = pRanges + ((thread + i) % numThreads);
+    while (true)
+    {
+      int index = __atomic_fetch_add(&pr->next, 1, __ATOMIC_RELAXED);
+      if (index >= pr->end) break;
+      RenderEngine(index);
+    }
+  }
+}
+
+void RenderService::RenderEngine(int index)
+{
+  uint64_t start = NowNsecs();
+  bool doshow = pEngines[index].updateEffects();
+  uint64_t nsecs = NowNsecs() - start;
+  if (nsecs > UINT32_MAX) nsecs = UINT32_MAX;
+
+  FrameStats *ps = pStats + index;
+  ++ps->frames;
+  if (doshow) ++ps->shows;
+  ps->nsecsTotal += nsecs;
+  if (ps->nsecsMax < nsecs) ps->nsecsMax = nsecs;
+  ++ps->histogram[HistBucket(nsecs)];
+}
+
+void RenderService::runFrame(uint32_t msecs)
+{
+  frameClock = msecs;
+
+  // split the engines evenly between the threads
+  for (int i = 0; i < numThreads; ++i)
+  {
+    pRanges[i].next = (numEngines * i) / numThreads;
+    pRanges[i].end  = (numEngines * (i+1)) / numThreads;
+  }
+
+  uint64_t start = NowNsecs();
+  pthread_barrier_wait((pthread_barrier_t*)pBarrier); // start the other threads
+  RenderAll(0);
+  pthread_barrier_wait((pthread_barrier_t*)pBarrier); // wait for them to finish
+  uint64_t nsecs = NowNsecs() - start;
+  if (nsecs > UINT32_MAX) nsecs = UINT32_MAX;
+
+  nsecsRunning += nsecs;
+  ++countFrames;
+  if (nsecsFrameMax < nsecs) nsecsFrameMax = nsecs;
+  ++frameHistogram[HistBucket(nsecs)];
+}
+
+void RenderService::report(FILE *fout, bool verbose)
+{
+  uint32_t histogram[RENDER_HIST_BUCKETS];
+  memset(histogram, 0, sizeof(histogram));
+
+  uint64_t updates = 0, nsecsTotal = 0;
+  uint32_t nsecsMax = 0;
+
+  for (int i = 0; i < numEngines; ++i)
+  {
+    FrameStats *ps = pStats + i;
+    updates += ps->frames;
+    nsecsTotal += ps->nsecsTotal;
+    if (nsecsMax < ps->nsecsMax) nsecsMax = ps->nsecsMax;
+    for (int j = 0; j < RENDER_HIST_BUCKETS; ++j) histogram[j] += ps->histogram[j];
+  }
+
+  double secs = nsecsRunning / 1e9;
+  if (secs <= 0) secs = 1e-9;
+
+  fprintf(fout, "Engines=%d Threads=%d Frames=%llu Time=%.3f secs\n",
+          numEngines, numThreads, (unsigned long long)countFrames, secs);
+
+  fprintf(fout, "Rate: %.1f frames/sec, %.1f engine updates/sec\n",
+          (countFrames / secs), (updates / secs));
+
+  fprintf(fout, "Frame usecs:  mean=%.1f p50=%.1f p99=%.1f p99.9=%.1f max=%.1f\n",
+          (countFrames ? (nsecsRunning / 1000.0 / countFrames) : 0.0),
+          HistPercentile(frameHistogram, 50, nsecsFrameMax),
+          HistPercentile(frameHistogram, 99, nsecsFrameMax),
+          HistPercentile(frameHistogram, 99.9, nsecsFrameMax), (nsecsFrameMax / 1000.0));
+
+  fprintf(fout, "Engine usecs: mean=%.1f p50=%.1f p99=%.1f p99.9=%.1f max=%.1f\n",
+          (updates ? (nsecsTotal / 1000.0 / updates) : 0.0),
+          HistPercentile(histogram, 50, nsecsMax),
+          HistPercentile(histogram, 99, nsecsMax),
+          HistPercentile(histogram, 99.9, nsecsMax), (nsecsMax / 1000.0));
+
+  if (verbose)
+  {
+    fprintf(fout, "Engine  Frames   Shows    Mean(us)  P99(us)   Max(us)\n");
+    for (int i = 0; i < numEngines; ++i)
+    {
+      FrameStats *ps = pStats + i;
+      fprintf(fout, "%6d  %7llu  %7llu  %8.1f  %8.1f  %8.1f\n", i,
+              (unsigned long long)ps->frames, (unsigned long long)ps->shows,
+              (ps->frames ? (ps->nsecsTotal / 1000.0 / ps->frames) : 0.0),
+              HistPercentile(ps->histogram, 99, ps->nsecsMax), (ps->nsecsMax / 1000.0));
+    }
+  }
+}
+
+#endif // HOST_BUILD
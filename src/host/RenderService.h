@@ -0,0 +1,79 @@
+// Host Render Service Class Definition
+// Runs many PixelNut engines (one per virtual strand) on a pool of threads.
+/*
+    Copyright (c) 2021, Greg de Valois
+    Software License Agreement (MIT License)
+    See license.txt for the terms of this license.
+*/
+
+#pragma once
+
+#if HOST_BUILD
+
+// Every engine is advanced once per frame, all with the same frame clock time
+// (returned by 'frameMsecs()', which should be used as the 'getMsecs' routine).
+// Each thread owns an equal range of the engines, and once finished with its own
+// takes the remaining engines from the ranges of the others, so that slow strands
+// don't leave threads idle. The time each engine takes to update is kept in a log
+// scaled histogram, from which the percentiles in the report are calculated.
+
+#define RENDER_HIST_BITS        2           // histogram buckets per doubling of time,
+#define RENDER_HIST_STEPS       (1 << RENDER_HIST_BITS) // which must be a power of 2
+#define RENDER_HIST_BUCKETS     (32 * RENDER_HIST_STEPS)
+
+class RenderService
+{
+public:
+  typedef struct
+  {
+    uint64_t frames;                        // number of updates
+    uint64_t shows;                         // number of those that changed the pixels
+    uint64_t nsecsTotal;                    // total time spent in those updates
+    uint32_t nsecsMax;                      // longest update
+    uint32_t histogram[RENDER_HIST_BUCKETS];
+  }
+  FrameStats;
+
+  // Allocates and initializes 'count' engines of 'pixels' each (laid out as 'layout'),
+  // with 'threads' threads (including the caller) to run them. Returns false if failed.
+  bool begin(int count, uint16_t pixels, int threads, const PixelLayout *layout=NULL);
+
+  PixelNutEngine *getEngine(int index) { return pEngines + index; }
+  int getEngineCount(void) { return numEngines; }
+
+  // Advances all engines with the frame clock set to 'msecs', returning when done.
+  void runFrame(uint32_t msecs);
+
+  // Prints aggregate frame rates, and per-engine times if 'verbose', to 'fout'.
+  void report(FILE *fout, bool verbose);
+
+  static uint32_t frameMsecs(void);         // current time of the frame clock
+
+  void RunThread(int thread);               // used internally by the threads
+
+private:
+  typedef struct
+  {
+    int next;                               // next engine to be taken (by anyone)
+    int end;                                // end of the range of engines
+    char filler[64 - (2 * sizeof(int))];    // keep each range on its own cache line
+  }
+  WorkRange;
+
+  PixelNutEngine *pEngines;
+  FrameStats *pStats;                       // one for each engine
+  WorkRange *pRanges;                       // one for each thread
+  int numEngines;
+  int numThreads;
+
+  void *pBarrier;                           // threads wait here for start/end of frames
+  uint64_t nsecsRunning;                    // total wall time spent running frames
+  uint64_t countFrames;                     // number of frames run
+  uint32_t nsecsFrameMax;                   // longest frame for all engines
+  uint32_t frameHistogram[RENDER_HIST_BUCKETS];
+
+  void RenderAll(int thread);
+  void RenderEngine(int index);
+};
+
+#endif // HOST_BUILD
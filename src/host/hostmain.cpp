@@ -0,0 +1,263 @@
+// Host Render Service Program
+// Runs a pattern on many virtual strands for previews and capacity planning.
+/*
+Copyright (c) 2021, Greg de Valois
+Software License Agreement (MIT License)
+See license.txt for the terms of this license.
+*/
+// A host build compiles this directory with "core", "plugins" and "xplugins" (run "make"
+// here), using HostArduino.h in place of <Arduino.h> and mydevices.h from here. Usage:
+//
+//    pixelnut [-n engines] [-p pixels] [-m width] [-t threads] [-f frames] [-r rate] [-R] [-v] [pattern]
+//    pixelnut -a audio [-s rate] [-S rate] [-b bands] [-R]
+//    pixelnut -a audio [-S rate] [-n engines] ... pattern
+//
+//    -n  number of engines (virtual strands) to run, default 200
+//    -p  number of pixels in each strand, default 300
+//    -m  pixels are a serpentine matrix with rows of this many, default is a single row
+//    -t  number of threads (including the main one), default is all cores
+//    -f  number of frames to run, default 600
+//    -r  frame clock rate in Hz, default 60
+//    -R  run in real time (waits for each frame), else as fast as possible
+//    -v  verbose: report times for each engine as well
+//
+//    -a  audio input (WAV file, raw 16-bit mono PCM, or "-" for standard input): without
+//        a pattern this only analyzes it, reporting how fast the spectrum is calculated,
+//        else patterns with audio plugins (Spectra) react to it, and onsets (beats) in it
+//        trigger them externally (as "I" commands)
+//    -s  audio sample rate analyzed (without a pattern), default 2000
+//    -S  sample rate of raw PCM, default is the same as analyzed
+//    -b  number of frequency bands (without a pattern), default 32
+
+#include "core.h"
+#include "host/RenderService.h"
+#include "host/AudioStream.h"
+#include "xplugins/freqfft.h"
+#include "xplugins/audiobus.h"
+
+#if HOST_BUILD
+
+#include <unistd.h>
+#include <time.h>
+
+#define DEF_ENGINES     200
+#define DEF_PIXELS      300
+#define DEF_FRAMES      600
+#define DEF_RATE_HZ     60
+#define DEF_PATTERN     "E50 B65 D10 H35 W80 T E20 B90 D30 C25 G R O3 N6 E20 B90 D30 H28 C45 U G T I E120 F1 I"
+
+#define DEF_AUDIO_RATE          2000
+#define DEF_AUDIO_BANDS         32
+#define AUDIO_MIN_DB            40  // same range of intensities as Spectra
+#define AUDIO_MAX_DB            80
+
+PixelNutSupport pixelNutSupport = PixelNutSupport(RenderService::frameMsecs);
+
+static RenderService renderService;
+
+void MsgFormat(const char *fmtstr, ...)
+{
+  va_list va;
+  va_start(va, fmtstr);
+  vfprintf(stderr, fmtstr, va);
+  va_end(va);
+  fputc('\n', stderr);
+}
+
+#if FREQ_FFT
+static uint64_t audioFrames = 0;
+
+static void AudioBand_CB(int pos, float value)
+{
+  if (pos == 0) ++audioFrames;
+}
+
+// analyzes the whole audio stream and reports how long it took
+static int RunAudio(const char *path, int rate, int rawrate, int bands, bool realtime)
+{
+  AudioStream stream(path, realtime, rawrate);
+  AudioIn_SetSource(&stream);
+
+  if (!FreqFFT_Init(rate, bands))
+  {
+    fprintf(stderr, "Failed to start analysis of %d bands\n", bands);
+    return 2;
+  }
+
+  struct timespec tstart, tend;
+  clock_gettime(CLOCK_MONOTONIC, &tstart);
+
+  FreqFFT_Begin(AUDIO_MIN_DB, AUDIO_MAX_DB);
+  if (AudioIn_Ended())
+  {
+    FreqFFT_Fini();
+    return 3;
+  }
+
+  while (!AudioIn_Ended())
+  {
+    FreqFFT_Next(AudioBand_CB);
+    if (realtime) usleep(1000);
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &tend);
+  double secs = (tend.tv_sec - tstart.tv_sec) + ((tend.tv_nsec - tstart.tv_nsec) / 1e9);
+  double audiosecs = (double)stream.samplesInput / stream.inputRate();
+  uint16_t overruns = AudioIn_Overruns();
+
+  FreqFFT_Fini();
+
+  printf("Audio: %.1f secs at %d Hz analyzed at %d Hz into %d bands\n",
+          audiosecs, stream.inputRate(), rate, bands);
+  printf("Spectra: %llu in %.3f secs = %.0f/sec (%.1f usecs each, %.0fx real time), overruns=%d\n",
+          (unsigned long long)audioFrames, secs, audioFrames / secs,
+          (secs * 1e6) / (audioFrames ? audioFrames : 1), audiosecs / secs, overruns);
+  return 0;
+}
+// triggers all engines on each onset detected in the audio (since the last frame)
+static void TriggerOnsets(void)
+{
+  static uint32_t onsetFrame = 0;
+  AudioSnapshot snap;
+
+  AudioBus_Update();
+  AudioBus_Read(&snap);
+
+  if (snap.onsetFrame != onsetFrame)
+  {
+    onsetFrame = snap.onsetFrame;
+
+    byte force = 1 + (byte)(snap.onset * (MAX_FORCE_VALUE-1));
+    for (int i = 0; i < renderService.getEngineCount(); ++i)
+      renderService.getEngine(i)->triggerForce(force);
+  }
+}
+#endif // FREQ_FFT
+
+int main(int argc, char **argv)
+{
+  int engines = DEF_ENGINES;
+  int pixels  = DEF_PIXELS;
+  int width   = 0;
+  int threads = sysconf(_SC_NPROCESSORS_ONLN);
+  int frames  = DEF_FRAMES;
+  int ratehz  = DEF_RATE_HZ;
+  bool realtime = false;
+  bool verbose = false;
+  const char *audio = NULL;
+  int arate   = DEF_AUDIO_RATE;
+  int prate   = 0;
+  int bands   = DEF_AUDIO_BANDS;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "n:p:m:t:f:r:Rva:s:S:b:")) != -1)
+  {
+    switch (opt)
+    {
+      case 'n': engines  = atoi(optarg); break;
+      case 'p': pixels   = atoi(optarg); break;
+      case 'm': width    = atoi(optarg); break;
+      case 't': threads  = atoi(optarg); break;
+      case 'f': frames   = atoi(optarg); break;
+      case 'r': ratehz   = atoi(optarg); break;
+      case 'R': realtime = true;         break;
+      case 'v': verbose  = true;         break;
+      case 'a': audio    = optarg;       break;
+      case 's': arate    = atoi(optarg); break;
+      case 'S': prate    = atoi(optarg); break;
+      case 'b': bands    = atoi(optarg); break;
+      default:
+      {
+        fprintf(stderr, "usage: %s [-n engines] [-p pixels] [-m width] [-t threads] [-f frames] "
+                        "[-r rate] [-R] [-v] [pattern]\n"
+                        "       %s -a audio [-s rate] [-S rate] [-b bands] [-R]\n", argv[0], argv[0]);
+        return 1;
+      }
+    }
+  }
+
+  if (audio != NULL)
+  {
+    #if FREQ_FFT
+    if ((arate < 1) || (prate < 0) || (bands < 1))
+    {
+      fprintf(stderr, "Invalid settings\n");
+      return 1;
+    }
+
+    // without a pattern only analyze, else it's the input for the patterns
+    if (optind >= argc) return RunAudio(audio, arate, prate, bands, realtime);
+
+    AudioIn_SetSource(new AudioStream(audio, realtime, prate));
+    if (!AudioBus_Subscribe()) // for the triggers, even if no plugin uses it
+    {
+      fprintf(stderr, "Failed to start audio: %s\n", audio);
+      return 2;
+    }
+    #else
+    fprintf(stderr, "Audio analysis not supported\n");
+    return 1;
+    #endif
+  }
+
+  const char *pattern = (optind < argc) ? argv[optind] : DEF_PATTERN;
+  if ((engines < 1) || (pixels < 1) || (pixels > UINT16_MAX) || (ratehz < 1) ||
+      (width < 0) || (width > pixels))
+  {
+    fprintf(stderr, "Invalid settings\n");
+    return 1;
+  }
+
+  PixelLayout layout = { (uint16_t)width, (uint16_t)(width ? ((pixels + width - 1) / width) : 0),
+                         LAYOUT_SERPENTINE, NULL };
+
+  if (!renderService.begin(engines, pixels, threads, (width ? &layout : NULL)))
+  {
+    fprintf(stderr, "Failed to start %d engines of %d pixels\n", engines, pixels);
+    return 2;
+  }
+
+  for (int i = 0; i < engines; ++i)
+  {
+    char cmdstr[MAXLEN_PATSTR+1];
+    strncpy(cmdstr, pattern, MAXLEN_PATSTR);
+    cmdstr[MAXLEN_PATSTR] = 0;
+
+    PixelNutEngine::Status status = renderService.getEngine(i)->execCmdStr(cmdstr);
+    if (status != PixelNutEngine::Status_Success)
+    {
+      fprintf(stderr, "Pattern failed: code=%d\n", status);
+      return 3;
+    }
+  }
+
+  struct timespec tnext;
+  clock_gettime(CLOCK_MONOTONIC, &tnext);
+  long nsecs_frame = 1000000000L / ratehz;
+
+  for (int i = 0; i < frames; ++i)
+  {
+    #if FREQ_FFT
+    if (audio != NULL) TriggerOnsets(); // layers with external triggers ("I") react to onsets
+    #endif
+
+    // frame clock advances evenly whether or not running in real time
+    renderService.runFrame(1 + (uint32_t)(((uint64_t)i * 1000) / ratehz));
+
+    if (realtime)
+    {
+      tnext.tv_nsec += nsecs_frame;
+      while (tnext.tv_nsec >= 1000000000L)
+      {
+        tnext.tv_nsec -= 1000000000L;
+        ++tnext.tv_sec;
+      }
+      clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &tnext, NULL);
+    }
+  }
+
+  renderService.report(stdout, verbose);
+  return 0;
+}
+
+#endif // HOST_BUILD
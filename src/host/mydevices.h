@@ -0,0 +1,16 @@
+// Host Device Settings
+// Used instead of the device's own "mydevices.h" in host builds.
+/*
+    Copyright (c) 2021, Greg de Valois
+    Software License Agreement (MIT License)
+    See license.txt for the terms of this license.
+*/
+
+#pragma once
+
+// engines are created by the host program, not for these strands
+#define STRAND_COUNT            1
+#define PIXEL_COUNTS            { 300 }
+#define PIXEL_PINS              { 0 }
+#define DPIN_LED                0
+#define APIN_SEED               0
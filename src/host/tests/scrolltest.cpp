@@ -0,0 +1,90 @@
+// Host Test: Scrolling in a Drawing Window
+// Runs DrawPush, which scrolls its pixels, in windows that start at and after the first pixel.
+/*
+Copyright (c) 2021, Greg de Valois
+Software License Agreement (MIT License)
+See license.txt for the terms of this license.
+*/
+// Each step pushes one more lit pixel in at track pixel 0, so after 'n' steps the track
+// pixels 0...n-1 are lit, and only those that are in the window are shown.
+
+#include "core.h"
+
+#if HOST_BUILD
+
+#define TEST_PIXELS             40
+#define TEST_WINDOWS            4
+
+static PixelNutEngine engines[TEST_WINDOWS]; // one for each test, never released (as on devices)
+static int countEngines = 0;
+
+static uint32_t nowMsecs = 1;
+static uint32_t TestMsecs(void) { return nowMsecs; }
+
+PixelNutSupport pixelNutSupport = PixelNutSupport(TestMsecs);
+
+void MsgFormat(const char *fmtstr, ...) {}
+
+// runs 'pattern' and checks the pixels shown after each step, returning the number of failures
+static int TestWindow(const char *pattern, int start, int length)
+{
+  PixelNutEngine &engine = engines[countEngines++];
+  if (!engine.init(TEST_PIXELS, PIXEL_BYTES, 8, 4, 0, false))
+  {
+    printf("FAIL %s: no memory\n", pattern);
+    return 1;
+  }
+
+  char cmdstr[100];
+  strcpy(cmdstr, pattern);
+  if (engine.execCmdStr(cmdstr) != PixelNutEngine::Status_Success)
+  {
+    printf("FAIL %s: bad pattern\n", pattern);
+    return 1;
+  }
+
+  int fails = 0;
+  int steps = 0;
+
+  for (int i = 0; (i < 2*TEST_PIXELS) && (steps < (start + length)); ++i)
+  {
+    nowMsecs += 10;
+    if (!engine.updateEffects()) continue;
+    ++steps;
+
+    for (int pos = 0; pos < TEST_PIXELS; ++pos)
+    {
+      const byte *ppix = engine.pDrawPixels + (pos * PIXEL_BYTES);
+      bool lit = ((ppix[0] | ppix[1] | ppix[2]) != 0);
+      bool want = ((pos >= start) && (pos < (start + length)) && (pos < steps));
+
+      if (lit != want)
+      {
+        printf("FAIL %s: step=%d pixel=%d lit=%d\n", pattern, steps, pos, lit);
+        ++fails;
+        break;
+      }
+    }
+  }
+
+  if (steps < (start + length))
+  {
+    printf("FAIL %s: only %d steps\n", pattern, steps);
+    ++fails;
+  }
+
+  if (!fails) printf("ok   %s\n", pattern);
+  return fails;
+}
+
+int main(int argc, char **argv)
+{
+  int fails = 0;
+  fails += TestWindow("E1 D0 T", 0, TEST_PIXELS);
+  fails += TestWindow("E1 D0 X0 Y20 T", 0, 20);
+  fails += TestWindow("E1 D0 X10 Y20 T", 10, 20);
+  fails += TestWindow("E1 D0 X30 Y10 T", 30, 10);
+  return (fails ? 1 : 0);
+}
+
+#endif // HOST_BUILD
@@ -25,7 +25,7 @@ public:
 };
 extern CustomCode *pCustomCode;
 
-extern PixelNutEngine pixelNutEngines[STRAND_COUNT];
+extern PixelNutEngine pixelNutEngines[ENGINE_COUNT];
 extern PixelNutEngine *pPixelNutEngine;
 
 extern void BlinkStatusLED(uint16_t slow, uint16_t fast);
@@ -35,6 +35,7 @@ extern void ExecAppCmd(char *cmdstr);
 extern void ExecPattern(char *pattern);
 
 extern bool doUpdate;
+extern void WakeMainLoop(void);
 
 #if DEV_PATTERNS
 extern byte codePatterns;
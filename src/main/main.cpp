@@ -20,6 +20,14 @@ extern void LoadCurPattern();
 
 bool doUpdate = true;             // false to not update display
 
+#if MSECS_IDLE_LOOP
+#if defined(ESP32)
+static TaskHandle_t loopTask = NULL; // task that runs loop(), notified to wake it
+#else
+static volatile bool wakeLoop = false;
+#endif
+#endif
+
 #if DEV_PATTERNS
 byte codePatterns = 0;            // number of internal patterns
 byte curPattern = 1;              // current pattern (1..codePatterns)
@@ -33,19 +41,45 @@ CustomCode *pCustomCode = &customcode;
 #if PIXELS_APA
 #include <SPI.h>
 SPISettings spiSettings(SPI_SETTINGS_FREQ, MSBFIRST, SPI_MODE0);
-PixelValOrder pixorder = {2,1,0}; // mapping of (RGB) to (BRG) for APA102
 #else
-PixelValOrder pixorder = {1,0,2}; // mapping of (RGB) to (GRB) for WS2812B
 NeoPixelShow *neoPixels[STRAND_COUNT];
 #endif
-PixelNutSupport pixelNutSupport = PixelNutSupport((GetMsecsTime)millis, &pixorder);
+PixelNutSupport pixelNutSupport = PixelNutSupport((GetMsecsTime)millis);
 
-PixelNutEngine pixelNutEngines[STRAND_COUNT];
+PixelNutEngine pixelNutEngines[ENGINE_COUNT];
 PixelNutEngine *pPixelNutEngine; // pointer to current engine
 
 static int pixcounts[] = PIXEL_COUNTS;
 static byte pinnums[] = PIXEL_PINS;
-#define PIXEL_BYTES 3 // fixed for all pixels
+#if defined(PIXEL_LAYOUTS)
+static const PixelLayout layouts[] = PIXEL_LAYOUTS;
+#endif
+
+#if VIRTUAL_CANVAS || defined(PIXEL_CLONES)
+#define STRAND_OUTPUTS 1                  // pixels shown aren't always those of the engine
+
+// Strands can render fewer pixels than they have (or none at all), the rest being shown
+// as clones of those rendered: then the pixels shown are in a separate output buffer.
+// With a virtual canvas the clones are the segments of the canvas shown on each strand,
+// and strands shown from a single segment of it in order are shown from the canvas itself.
+#if defined(PIXEL_CLONES)
+static const PixelClone clones[] = PIXEL_CLONES;
+#define CLONE_COUNT (sizeof(clones) / sizeof(clones[0]))
+#else
+static PixelClone clones[STRAND_COUNT];   // strands end to end, set by InitCanvas()
+#define CLONE_COUNT STRAND_COUNT
+#endif
+
+#if VIRTUAL_CANVAS
+static bool cloneViews[CLONE_COUNT];      // true if clone is shown from the canvas, not copied
+#elif defined(PIXEL_RENDERS)
+static int rendercounts[] = PIXEL_RENDERS;
+#else
+static int rendercounts[] = PIXEL_COUNTS;
+#endif
+
+static byte *outPixels[STRAND_COUNT];     // pixels shown for each strand
+#endif
 
 #if DEBUG_OUTPUT
 #warning("Debug mode is enabled")
@@ -72,6 +106,7 @@ void DisplayConfiguration(void)
 
   DBGOUT((F("Configuration:")));
   DBGOUT((F("  STRAND_COUNT         = %d"), STRAND_COUNT));
+  DBGOUT((F("  VIRTUAL_CANVAS       = %d"), VIRTUAL_CANVAS));
   DBGOUT((F("  PIXEL_COUNTS         = %s"), pixstr));
   DBGOUT((F("  PIXEL_PINS           = %s"), pinstr));
   DBGOUT((F("  MAXLEN_PATSTR        = %d"), MAXLEN_PATSTR));
@@ -102,8 +137,13 @@ void DisplayConfiguration(void)
 
 void ShowPixels(int index)
 {
+  #if STRAND_OUTPUTS
+  int pcount = pixcounts[index];
+  byte *ppix = outPixels[index];
+  #else
   int pcount = pixelNutEngines[index].numPixels;
   byte *ppix = pixelNutEngines[index].pDrawPixels;
+  #endif
 
   #if PIXELS_APA
 
@@ -153,6 +193,158 @@ void ShowPixels(int index)
   #endif
 }
 
+#if VIRTUAL_CANVAS
+// Initializes the single engine to render the canvas, and where each strand is shown from:
+// those that are only a part of the canvas are shown directly from it, the others (reversed,
+// spread out, or made up of more than one part) have their own buffer the parts are copied to.
+static bool InitCanvas(void)
+{
+  int count = 0;
+  #if defined(CANVAS_PIXELS)
+  count = CANVAS_PIXELS;
+  #else
+  for (int i = 0; i < STRAND_COUNT; ++i) count += pixcounts[i];
+  #endif
+
+  #if !defined(PIXEL_CLONES)
+  int pos = 0;
+  for (int i = 0; i < STRAND_COUNT; ++i)
+  {
+    clones[i] = { 0, (byte)i, (uint16_t)pos, (uint16_t)pixcounts[i], 0, 1 };
+    pos += pixcounts[i];
+  }
+  #endif
+
+  #if defined(PIXEL_LAYOUTS)
+  const PixelLayout *playout = &layouts[0]; // of the canvas
+  #else
+  const PixelLayout *playout = NULL;
+  #endif
+
+  if ((count <= 0) || (count > UINT16_MAX) ||
+      !pixelNutEngines[0].init(count, PIXEL_BYTES, NUM_PLUGIN_LAYERS, NUM_PLUGIN_TRACKS,
+                               PIXEL_OFFSET, false, playout))
+    return false;
+
+  for (int i = 0; i < STRAND_COUNT; ++i)
+  {
+    int parts = 0;
+    int view = -1;
+
+    for (unsigned int j = 0; j < CLONE_COUNT; ++j)
+      if ((clones[j].source == 0) && (clones[j].dest == i))
+      {
+        ++parts;
+        if ((clones[j].destPos == 0) && ((clones[j].destStep == 0) || (clones[j].destStep == 1)) &&
+            (clones[j].count >= pixcounts[i]) && ((clones[j].srcPos + pixcounts[i]) <= count))
+          view = j;
+      }
+
+    if ((parts == 1) && (view >= 0))
+    {
+      cloneViews[view] = true;
+      outPixels[i] = pixelNutEngines[0].pDrawPixels + (clones[view].srcPos * PIXEL_BYTES);
+    }
+    else
+    {
+      outPixels[i] = (byte*)malloc(pixcounts[i] * PIXEL_BYTES);
+      if (outPixels[i] == NULL) return false;
+      memset(outPixels[i], 0, (pixcounts[i] * PIXEL_BYTES));
+    }
+
+    DBGOUT((F("Canvas: strand=%d parts=%d view=%d"), i, parts, (view >= 0)));
+  }
+
+  return true;
+}
+
+#elif STRAND_OUTPUTS
+// Initializes the engine for a strand that renders only some of its pixels, or all of them
+// with clones shown over some (the pixels rendered are copied into the output before the
+// clones are), or none of them: then the engine has no layers or tracks (no patterns are
+// run on it), and its display buffer is the output for the clones. Strands rendering all
+// their pixels without clones are shown from their display buffer as usual.
+static bool InitCloneStrand(int index, const PixelLayout *playout)
+{
+  int count = rendercounts[index];
+  if (count > pixcounts[index]) count = pixcounts[index];
+
+  bool cloned = false;
+  for (unsigned int i = 0; i < CLONE_COUNT; ++i)
+    if ((clones[i].dest == index) && (clones[i].source < ENGINE_COUNT)) cloned = true;
+
+  if ((count <= 0) || ((count == pixcounts[index]) && !cloned))
+  {
+    byte layers = (count > 0) ? NUM_PLUGIN_LAYERS : 0;
+    byte tracks = (count > 0) ? NUM_PLUGIN_TRACKS : 0;
+
+    if (!pixelNutEngines[index].init(pixcounts[index], PIXEL_BYTES, layers, tracks,
+                                     PIXEL_OFFSET, false, playout))
+      return false;
+
+    outPixels[index] = pixelNutEngines[index].pDrawPixels;
+    return true;
+  }
+
+  if (!pixelNutEngines[index].init(count, PIXEL_BYTES, NUM_PLUGIN_LAYERS, NUM_PLUGIN_TRACKS,
+                                   PIXEL_OFFSET, false, playout))
+    return false;
+
+  outPixels[index] = (byte*)malloc(pixcounts[index] * PIXEL_BYTES);
+  if (outPixels[index] == NULL) return false;
+  memset(outPixels[index], 0, (pixcounts[index] * PIXEL_BYTES));
+  return true;
+}
+
+#endif
+
+#if STRAND_OUTPUTS
+// Updates the engines, then copies the clones of those that have changed, and all the clones
+// into strands whose rendered pixels have changed (since those were copied over them), and
+// shows all the strands that have been changed by either.
+static void UpdateClones(void)
+{
+  bool changed[ENGINE_COUNT];
+  bool show[STRAND_COUNT];
+
+  for (int i = 0; i < ENGINE_COUNT; ++i)
+    changed[i] = pixelNutEngines[i].updateEffects();
+
+  for (int i = 0; i < STRAND_COUNT; ++i)
+  {
+    #if VIRTUAL_CANVAS
+    show[i] = false; // shown only from the canvas
+    #else
+    show[i] = changed[i];
+
+    if (changed[i] && (outPixels[i] != pixelNutEngines[i].pDrawPixels))
+      memcpy(outPixels[i], pixelNutEngines[i].pDrawPixels, (pixelNutEngines[i].numPixels * PIXEL_BYTES));
+    #endif
+  }
+
+  for (unsigned int i = 0; i < CLONE_COUNT; ++i)
+  {
+    const PixelClone *pclone = clones + i;
+    if ((pclone->source >= ENGINE_COUNT) || (pclone->dest >= STRAND_COUNT)) continue;
+
+    #if VIRTUAL_CANVAS
+    if (!changed[pclone->source]) continue;
+    #else
+    if (!changed[pclone->source] && !changed[pclone->dest]) continue;
+    #endif
+
+    #if VIRTUAL_CANVAS
+    if (!cloneViews[i]) // else already there
+    #endif
+    pixelNutEngines[pclone->source].cloneOutput(pclone, outPixels[pclone->dest], pixcounts[pclone->dest]);
+    show[pclone->dest] = true;
+  }
+
+  for (int i = 0; i < STRAND_COUNT; ++i)
+    if (show[i]) ShowPixels(i);
+}
+#endif
+
 void setup()
 {
   SetupLED(); // status LED: indicate in setup now
@@ -182,6 +374,15 @@ void setup()
   CountPatterns(); // have internal stored patterns
   #endif
 
+  #if VIRTUAL_CANVAS
+  // DBGOUT((F("Alloc pixelnut canvas...")));
+  if (!InitCanvas())
+  {
+    DBGOUT((F("Failed to initialize pixel canvas")));
+    ErrorHandler(2, PixelNutEngine::Status_Error_Memory, true);
+  }
+  #endif
+
   // alloc arrays, turn off pixels, init patterns
   for (int i = 0; i < STRAND_COUNT; ++i)
   {
@@ -205,15 +406,32 @@ void setup()
     }
     #endif
 
+    #if VIRTUAL_CANVAS
+    ShowPixels(i); // turn off pixels
+    if (i >= ENGINE_COUNT) continue; // shown from the canvas
+    #else
     // DBGOUT((F("Alloc pixelnut engines...")));
-    if (!pixelNutEngines[i].init(pixcounts[i], PIXEL_BYTES, NUM_PLUGIN_LAYERS, NUM_PLUGIN_TRACKS, PIXEL_OFFSET))
+    #if defined(PIXEL_LAYOUTS)
+    const PixelLayout *playout = &layouts[i];
+    #else
+    const PixelLayout *playout = NULL; // pixels are a single row
+    #endif
+
+    #if defined(PIXEL_CLONES)
+    if (!InitCloneStrand(i, playout))
+    #else
+    if (!pixelNutEngines[i].init(pixcounts[i], PIXEL_BYTES, NUM_PLUGIN_LAYERS, NUM_PLUGIN_TRACKS,
+                                 PIXEL_OFFSET, false, playout))
+    #endif
     {
       DBGOUT((F("Failed to initialize pixel engine, strand=%d"), i));
       ErrorHandler(2, PixelNutEngine::Status_Error_Memory, true);
     }
 
-    pPixelNutEngine = &pixelNutEngines[i];
     ShowPixels(i); // turn off pixels
+    #endif
+
+    pPixelNutEngine = &pixelNutEngines[i];
 
     FlashSetStrand(i);
     FlashInitStrand(newflash); // get curPattern and settings from flash, set engine properties
@@ -227,6 +445,10 @@ void setup()
     SetupTriggerControls();
     SetupPatternControls();
 
+    #if defined(PIXEL_CLONES) && !VIRTUAL_CANVAS
+    if (rendercounts[i] <= 0) continue; // only shows clones
+    #endif
+
     #if CLIENT_APP
     char cmdstr[MAXLEN_PATSTR+1];
     FlashGetPatStr(cmdstr); // get pattern string previously stored in flash
@@ -242,6 +464,10 @@ void setup()
     pPixelNutEngine = &pixelNutEngines[0];
   }
 
+  #if MSECS_IDLE_LOOP && defined(ESP32)
+  loopTask = xTaskGetCurrentTaskHandle(); // before any commands can be received
+  #endif
+
   pCustomCode->setup(); // custom initialization here
 
   #if defined(ESP32)
@@ -257,6 +483,55 @@ void setup()
   DBGOUT((F("** Setup complete **")));
 }
 
+// Called when a command has been received from outside of loop() (such as
+// from a BLE callback), so that an idle loop() runs again without waiting.
+void WakeMainLoop(void)
+{
+  #if MSECS_IDLE_LOOP
+  #if defined(ESP32)
+  if (loopTask != NULL) xTaskNotifyGive(loopTask);
+  #else
+  wakeLoop = true;
+  #endif
+  #endif
+}
+
+#if MSECS_IDLE_LOOP
+// Waits until the earliest time any engine has something to draw, or until woken by
+// a command, but no longer than MSECS_IDLE_LOOP so that controls and those clients
+// that must be polled are still checked often enough.
+static void IdleLoop(void)
+{
+  uint32_t msecs = MSECS_IDLE_LOOP;
+
+  if (doUpdate)
+    for (int i = 0; (i < ENGINE_COUNT) && (msecs > 0); ++i)
+    {
+      uint32_t due = pixelNutEngines[i].msecsUntilDue();
+      if (due < msecs) msecs = due;
+    }
+
+  if (msecs == 0) return;
+
+  #if defined(ESP32)
+  // blocks this task: the idle task runs (and light sleeps if power management allows)
+  ulTaskNotifyTake(pdFALSE, pdMS_TO_TICKS(msecs));
+  #else
+  uint32_t start = millis();
+  while (!wakeLoop && ((millis() - start) < msecs))
+  {
+    #if COM_SERIAL
+    if (Serial.available() > 0) break; // command is arriving
+    #endif
+    #if defined(__arm__)
+    __asm__ volatile("wfi"); // sleep until the next interrupt (at least the msecs tick)
+    #endif
+  }
+  wakeLoop = false;
+  #endif
+}
+#endif
+
 void loop()
 {
   pCustomCode->loop(); // custom processing here
@@ -272,7 +547,17 @@ void loop()
 
   // if enabled: display new pixel values if anything has changed
   if (doUpdate)
+  {
+    #if STRAND_OUTPUTS
+    UpdateClones();
+    #else
     for (int i = 0; i < STRAND_COUNT; ++i)
       if (pixelNutEngines[i].updateEffects())
         ShowPixels(i);
+    #endif
+  }
+
+  #if MSECS_IDLE_LOOP
+  IdleLoop();
+  #endif
 }
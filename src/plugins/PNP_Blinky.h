@@ -1,8 +1,8 @@
 // What Effect Does:
 //
 //    Blinks on and off random pixels in the current color and brightness.
-//    The number of pixels cleared/set each step is determined by the pixel
-//    count property.
+//    How often pixels change is determined by the pixel count property.
+//    Uses the per-pixel phase support, which allocates 2 bytes of memory per pixel.
 //
 // Calling trigger():
 //
@@ -10,8 +10,8 @@
 //
 // Calling nextstep():
 //
-//    Clears some pixels at random locations, then sets some pixels at random locations
-//    to the colors currently set in the property for the current track.
+//    Advances each pixel through its own on/off cycle, each at a different rate, so
+//    that about 'pixCount' pixels are turned on or off each step.
 //
 // Properties Used:
 //
@@ -23,33 +23,28 @@
 //    none
 //
 
+#include "core/PixelNutPhases.h"    // support class for the per-pixel phase effects
+
 class PNP_Blinky : public PixelNutPlugin
 {
 public:
+  ~PNP_Blinky() { pixelNutPhases.phaseDelete(pdata); }
+
   void begin(uint16_t id, uint16_t pixlen)
   {
     pixLength = pixlen;
+    pdata = pixelNutPhases.phaseCreate(pixlen, 64, 192);
   }
 
   void nextstep(PixelNutHandle handle, PixelNutSupport::DrawProps *pdraw)
   {
-    //pixelNutSupport.msgFormat(F("Blinky: pixcount=%d r=%d g=%d b=%d"), pdraw->pixCount, pdraw->r, pdraw->g, pdraw->b);
-
-    // turn some off
-    for (uint16_t i = 0; i < pdraw->pixCount; ++i)
-    {
-      uint16_t pos = random(0, pixLength);
-      pixelNutSupport.setPixel(handle, pos, 0,0,0);
-    }
-
-    // turn some back on
-    for (uint16_t i = 0; i < pdraw->pixCount; ++i)
-    {
-      uint16_t pos = random(0, pixLength);
-      pixelNutSupport.setPixel(handle, pos, pdraw->r, pdraw->g, pdraw->b);
-    }
+    // each pixel changes twice a cycle, which at the average rate of 128 takes
+    // (512 * PHASE_SPEED_ONE) / speed steps, so set speed for 'pixCount' changes
+    uint32_t speed = ((uint32_t)pdraw->pixCount * 256 * PHASE_SPEED_ONE) / pixLength;
+    pixelNutPhases.phaseDraw(pdata, pdraw, handle, speed, PixelNutPhases::PhaseRamp_Blink);
   }
 
 private:
   uint16_t pixLength;
+  PixelNutPhases::phaseData pdata;
 };
@@ -45,11 +45,11 @@ public:
   {
     if (!active) return;
 
-    int16_t count = pdraw->pixCount;
+    int count = pdraw->pixCount;
     if (count>= pixLength) --count; // need at least one pixel free
 
     if (headPos < 0) headPos = 0;
-    int16_t tailpos = headPos + count - 1;
+    int tailpos = headPos + count - 1;
     if (tailpos > (pixLength-1))
     {
       tailpos = (pixLength-1);
@@ -64,17 +64,16 @@ public:
     if (lastCount > count)
     {
       // compensate for previous adjustment to headPos
-      int16_t endpos = (headPos + lastCount-1);
+      int endpos = (headPos + lastCount-1);
       if (endpos > (pixLength-1)) endpos = (pixLength-1);
       else endpos += (goForward ? -1 : 1);
 
-      for (int16_t i = tailpos; i <= endpos; ++i)
-        pixelNutSupport.setPixel(handle, i, 0,0,0);
+      if (tailpos <= endpos) pixelNutSupport.clearPixels(handle, tailpos, endpos);
     }
     lastCount = count;
 
-    for (int16_t i = headPos; i <= tailpos; ++i)
-      pixelNutSupport.setPixel(handle, i, pdraw->r, pdraw->g, pdraw->b);
+    if (headPos <= tailpos)
+      pixelNutSupport.fillPixels(handle, headPos, (tailpos - headPos + 1), pdraw->r, pdraw->g, pdraw->b);
 
     if (goForward)
     {
@@ -108,5 +107,5 @@ private:
   byte forceVal;
   bool active;
   bool goForward;
-  int16_t pixLength, lastCount, headPos;
+  int pixLength, lastCount, headPos;
 };
@@ -63,7 +63,7 @@ public:
         --pdraw->pcentBright;
         stepCount = 0;
 
-        pixelNutSupport.makeColorVals(pdraw);
+        pixelNutSupport.colorChanged(pdraw);
 
         //pixelNutSupport.msgFormat(F("BrightSurge: percent %d => %d"), pdraw->pcentBright, minBright);
       }
@@ -62,7 +62,7 @@ public:
     else if (bright > 100) pdraw->pcentBright = 100;
     else                   pdraw->pcentBright = bright;
 
-    pixelNutSupport.makeColorVals(pdraw);
+    pixelNutSupport.colorChanged(pdraw);
 
     //pixelNutSupport.msgFormat(F("BrightWave: force=%d bright=%d angle=%.1f"),
     //  forceVal, pdraw->pcentBright, ((angleNext*DEGREES_PER_CIRCLE)/RADIANS_PER_CIRCLE));
@@ -88,7 +88,7 @@ public:
 
     pdraw->dvalueHue = curHue;
     pdraw->pcentWhite = curWhite;
-    pixelNutSupport.makeColorVals(pdraw);
+    pixelNutSupport.makeColorVals(pdraw); // needed now: properties are set back below
 
     // to detect changes
     pdraw->dvalueHue = endHue;
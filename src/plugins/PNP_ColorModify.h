@@ -47,6 +47,6 @@ public:
     //pixelNutSupport.msgFormat(F("ColorModify2: force=%d%% hue=%d white=%d"),
     //    (int)(pcentforce*100), pdraw->dvalueHue, pdraw->pcentWhite);
  
-    pixelNutSupport.makeColorVals(pdraw);
+    pixelNutSupport.colorChanged(pdraw);
   }
 };
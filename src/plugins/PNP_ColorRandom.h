@@ -29,7 +29,7 @@ public:
   {
     pdraw->dvalueHue  = random(0, MAX_DVALUE_HUE+1);
     pdraw->pcentWhite = random(0, 60); // keep under 60% white
-    pixelNutSupport.makeColorVals(pdraw);
+    pixelNutSupport.colorChanged(pdraw);
 
     //pixelNutSupport.msgFormat(F("ColorRandom: hue=%d white=%d"), pdraw->dvalueHue, pdraw->pcentWhite);
   }
@@ -1,6 +1,6 @@
 // What Effect Does:
 //
-//    Using the built-in comet handling functions, creates one or more comets (up to 12),
+//    Using the built-in comet handling functions, creates one or more comets (up to MAX_COMET_HEADS),
 //    such that they either loop around the drawing window continuously, or disappear as 
 //    they "fall off" of the end of the window.
 //
@@ -44,9 +44,9 @@ public:
     pixLength = pixlen;
     myid = id;
 
-    uint16_t maxheads = pixLength / 8; // one head for every 8 pixels up to 12
+    uint16_t maxheads = pixLength / 8; // one head for every 8 pixels up to the max
     if (maxheads < 1) maxheads = 1; // but at least one
-    else if (maxheads > 12) maxheads = 12;
+    else if (maxheads > MAX_COMET_HEADS) maxheads = MAX_COMET_HEADS;
 
     cdata = pixelNutComets.cometHeadCreate(maxheads);
     if ((cdata == NULL) && (maxheads > 1)) // try for at least 1
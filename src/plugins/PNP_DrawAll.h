@@ -8,7 +8,7 @@
 //
 // Calling nextstep():
 //
-//    Draws all pixels to the same color.
+//    Draws all pixels to the same color, then is idle until the properties change.
 //
 // Properties Used:
 //
@@ -31,8 +31,8 @@ public:
 
   void nextstep(PixelNutHandle handle, PixelNutSupport::DrawProps *pdraw)
   {
-    for (uint16_t i = 0; i < pixLength; ++i)
-      pixelNutSupport.setPixel(handle, i, pdraw->r, pdraw->g, pdraw->b);
+    pixelNutSupport.fillPixels(handle, 0, pixLength, pdraw->r, pdraw->g, pdraw->b);
+    pixelNutSupport.setIdle(handle); // nothing changes until properties do
   }
 
 private:
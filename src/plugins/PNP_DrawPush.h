@@ -12,6 +12,7 @@
 // Calling nextstep():
 //
 //    Shifts (pushes) all pixels by one, then draws a single pixel to position 0.
+//    The shift scrolls the pixel buffer, so only that one pixel is actually drawn.
 //
 // Properties Used:
 //
@@ -45,11 +46,7 @@ public:
     //pixelNutSupport.msgFormat(F("DrawPush: dodraw=%d curpos=%d r=%d g=%d b=%d"),
     //                            dodraw, curPos, pdraw->r, pdraw->g, pdraw->b);
 
-    if (curPos)
-    {
-      uint16_t endpos = (curPos < pixLength-1) ? curPos : curPos-1;
-      pixelNutSupport.movePixels(handle, 0, endpos, 1); // shift down one
-    }
+    if (curPos) pixelNutSupport.scrollPixels(handle, 1); // shift down one
 
     if (doDraw)
          pixelNutSupport.setPixel(handle, 0, pdraw->r, pdraw->g, pdraw->b);
@@ -9,7 +9,8 @@
 //
 // Calling nextstep():
 //
-//    Advances the effect by one pixel, by redrawing all of the pixels.
+//    Advances the effect by one pixel, by scrolling the pixels and drawing the one exposed
+//    at the start. All of the pixels are redrawn only if the count or color has changed.
 //
 // Properties Used:
 //
@@ -29,12 +30,16 @@ public:
   {
     pixLength = pixlen;
     lastCount = 0;
+    lastR = lastG = lastB = 0;
   }
 
   void nextstep(PixelNutHandle handle, PixelNutSupport::DrawProps *pdraw)
   {
+    bool redraw = ((lastR != pdraw->r) || (lastG != pdraw->g) || (lastB != pdraw->b));
+
     if (lastCount != pdraw->pixCount)
     {
+      redraw = true;
       lastCount = pdraw->pixCount;
       uint16_t spokeCount = lastCount;
       spaceCount = (pixLength - spokeCount);
@@ -50,16 +55,24 @@ public:
       //pixelNutSupport.msgFormat(F("Ferris: count=%d spaces=%d"), spokeCount, spokeSpaces);
     }
 
-    uint16_t count = spaceCount;
-
-    for (uint16_t i = 0; i < pixLength; ++i) // draw all pixels
+    if (redraw)
     {
-      if (!count--)
-      {
-        count = spokeSpaces;
+      lastR = pdraw->r;
+      lastG = pdraw->g;
+      lastB = pdraw->b;
+
+      pixelNutSupport.clearPixels(handle, 0, pixLength-1); // clear spaces, then draw spokes
+
+      for (uint16_t i = spaceCount; i < pixLength; i += (spokeSpaces + 1))
         pixelNutSupport.setPixel(handle, i, pdraw->r, pdraw->g, pdraw->b);
-      }
-      else pixelNutSupport.setPixel(handle, i, 0,0,0);
+    }
+    else // spokes move down one, and either one or a space is next
+    {
+      pixelNutSupport.scrollPixels(handle, 1);
+
+      if (!spaceCount)
+           pixelNutSupport.setPixel(handle, 0, pdraw->r, pdraw->g, pdraw->b);
+      else pixelNutSupport.setPixel(handle, 0, 0,0,0);
     }
 
     if (++spaceCount > spokeSpaces)
@@ -68,4 +81,5 @@ public:
 
 private:
   uint16_t pixLength, lastCount, spokeSpaces, spaceCount;
+  byte lastR, lastG, lastB;
 };
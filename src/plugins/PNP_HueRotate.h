@@ -61,7 +61,7 @@ public:
     //pixelNutSupport.msgFormat(F("HueRotate: degrees=%d"), (int)curDegrees);
 
     pdraw->dvalueHue = (int)curDegrees;
-    pixelNutSupport.makeColorVals(pdraw);
+    pixelNutSupport.colorChanged(pdraw);
 
     if (doResetAtEnd && (++pixChanged >= pixLength))
     {
@@ -31,7 +31,7 @@ public:
   {
     pdraw->dvalueHue = (uint16_t)(((float)force / MAX_FORCE_VALUE) * MAX_DVALUE_HUE);
 
-    pixelNutSupport.makeColorVals(pdraw);
+    pixelNutSupport.colorChanged(pdraw);
 
     //pixelNutSupport.msgFormat(F("SetTheHue: hue=%d"), pdraw->dvalueHue);
   }
@@ -12,7 +12,8 @@
 //
 // Calling nextstep():
 //
-//    Draws each pixel, scaling the brightness up/down from the current value.
+//    Draws each pixel, scaling the brightness up/down from the current value,
+//    composing a chunk of pixels at a time to be copied all together.
 //
 // Properties Used:
 //
@@ -41,12 +42,27 @@ public:
     float angle_step = (RADIANS_PER_CIRCLE / 10.0) * ((float)count / pixLength);
     float angle = angleNext;
 
-    for (uint16_t i = 0; i < pixLength; ++i, angle += angle_step)
+    byte rgb[SPAN_CHUNK_PIXELS * 3];
+
+    for (uint16_t i = 0; i < pixLength; ) // compose and copy a chunk of pixels at a time
     {
-      float scale = ((cos(angle) + 1.0) / 4.0) + 0.5; // scale from 50-100%
-      pixelNutSupport.setPixel(handle, i, pdraw->r, pdraw->g, pdraw->b, scale);
+      uint16_t count = pixLength - i;
+      if (count > SPAN_CHUNK_PIXELS) count = SPAN_CHUNK_PIXELS;
+
+      byte *prgb = rgb;
+      for (uint16_t j = 0; j < count; ++j, angle += angle_step)
+      {
+        float scale = ((cos(angle) + 1.0) / 4.0) + 0.5; // scale from 50-100%
+        uint16_t level = pixelNutSupport.gammaCorrect(scale * MAX_PIXEL_VALUE);
+        *prgb++ = (pdraw->r * level) / MAX_PIXEL_VALUE;
+        *prgb++ = (pdraw->g * level) / MAX_PIXEL_VALUE;
+        *prgb++ = (pdraw->b * level) / MAX_PIXEL_VALUE;
+
+        //pixelNutSupport.msgFormat(F("LightWave: scale=%3d%%, r=%d, g=%d, b=%d"), (int)(scale*100), pdraw->r, pdraw->g, pdraw->b);
+      }
 
-      //pixelNutSupport.msgFormat(F("LightWave: scale=%3d%%, r=%d, g=%d, b=%d"), (int)(scale*100), pdraw->r, pdraw->g, pdraw->b);
+      pixelNutSupport.copyPixels(handle, i, count, rgb);
+      i += count;
     }
     //pixelNutSupport.msgFormat(F("LightWave: angleNext * 100 = %d"), (int)(angleNext * 100));
 
@@ -2,6 +2,7 @@
 //
 //    Randomly sets pixels to the current color with a random brightness level.
 //    The number of pixels set each step is determined by the pixel count property.
+//    Uses the per-pixel phase support, which allocates 2 bytes of memory per pixel.
 //
 // Calling trigger():
 //
@@ -9,47 +10,41 @@
 //
 // Calling nextstep():
 //
-//    Sets random pixels 'pixCount' times to a random brightness that's greater than 10%.
+//    Advances each pixel through its own sequence of random brightness levels that are
+//    greater than 10%, each at a different rate, so that about 'pixCount' change each step.
 //
 // Properties Used:
 //
-//    dvalueHue, pcentWhite - determines the color.
-//    pcentBright - determines the maximum brightness.
+//    r,g,b - the current color values (pcentBright determines the maximum brightness).
 //    pixCount - number of pixels set each nextstep().
 //
 // Properties Affected:
 //
-//    r,g,b - the current color values.
+//    none
 //
 
+#include "core/PixelNutPhases.h"    // support class for the per-pixel phase effects
+
 class PNP_Noise : public PixelNutPlugin
 {
 public:
+  ~PNP_Noise() { pixelNutPhases.phaseDelete(pdata); }
 
   void begin(uint16_t id, uint16_t pixlen)
   {
     pixLength = pixlen;
+    pdata = pixelNutPhases.phaseCreate(pixlen, 64, 192);
   }
 
   void nextstep(PixelNutHandle handle, PixelNutSupport::DrawProps *pdraw)
   {
-    PixelNutSupport::DrawProps p;
-
-    // use current hue and whiteness
-    p.dvalueHue = pdraw->dvalueHue;
-    p.pcentWhite = pdraw->pcentWhite;
-
-    for (uint16_t i = 0; i < pdraw->pixCount; ++i)
-    {
-      // set random brightness within limits (>= 10%)
-      p.pcentBright = random(10, pdraw->pcentBright+1);
-      pixelNutSupport.makeColorVals(&p);
-
-      short pos = random(0, pixLength);
-      pixelNutSupport.setPixel(handle, pos, p.r, p.g, p.b);
-    }
+    // each pixel changes level every phase, which at the average rate of 128 takes
+    // (2 * PHASE_SPEED_ONE) / speed steps, so set speed for 'pixCount' changes
+    uint32_t speed = ((uint32_t)pdraw->pixCount * 2 * PHASE_SPEED_ONE) / pixLength;
+    pixelNutPhases.phaseDraw(pdata, pdraw, handle, speed, PixelNutPhases::PhaseRamp_Noise);
   }
 
 private:
   uint16_t pixLength;
+  PixelNutPhases::phaseData pdata;
 };
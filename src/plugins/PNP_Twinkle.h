@@ -2,7 +2,7 @@
 //
 //    Scales brightness levels individually up and down to create a twinkle effect.
 //    The number of pixels affected is determined by the pixel count property.
-//    Allocates 2 bytes of memory per number of pixels.
+//    Uses the per-pixel phase support, which allocates 2 bytes of memory per pixel.
 //
 // Calling trigger():
 //
@@ -10,8 +10,9 @@
 //
 // Calling nextstep():
 //
-//    Sets some number of pixels to the current color with a calculated amount of
-//    brightness, which varies up and down to create a twinkle effect.
+//    Sets some number of pixels to the current color with a brightness that rises
+//    and falls, then stays dark for a while, each pixel at its own rate, to create
+//    a twinkle effect.
 //
 // Properties Used:
 //
@@ -23,94 +24,25 @@
 //    none
 //
 
+#include "core/PixelNutPhases.h"    // support class for the per-pixel phase effects
+
 class PNP_Twinkle : public PixelNutPlugin
 {
 public:
-  ~PNP_Twinkle() { if (pbytes != NULL) free(pbytes); }
+  ~PNP_Twinkle() { pixelNutPhases.phaseDelete(pdata); }
 
   void begin(uint16_t id, uint16_t pixlen)
   {
-    pixLength = pixlen;
-    pbytes = (int16_t*)malloc(pixLength * sizeof(int16_t));
-
-    maxvalue = 50;
-
-    if (pbytes != NULL)
-      for (uint16_t i = 0; i < pixLength; ++i)
-        pbytes[i] = random(0, ((maxvalue * 2) + maxvalue)) - maxvalue;
+    // twinkles take about 128 steps (rises and falls in 96, dark for the rest)
+    pdata = pixelNutPhases.phaseCreate(pixlen, 96, 160);
   }
 
   void nextstep(PixelNutHandle handle, PixelNutSupport::DrawProps *pdraw)
   {
-    if (pbytes == NULL) return;
-    
-    int draw = 0, skip = 0;
-
-    for (uint16_t i = 0; i < pixLength; ++i)
-    {
-      if (!draw && !skip)
-      {
-        if (pdraw->pixCount == 1)
-        {
-          draw = 0;
-          skip = pixLength;
-        }
-        else if (pdraw->pixCount == pixLength)
-        {
-          draw = pixLength;
-          skip = 0;
-        }
-        else if (pdraw->pixCount > (pixLength - pdraw->pixCount))
-        {
-          draw = pdraw->pixCount / (pixLength - pdraw->pixCount);
-          skip = 1;
-        }
-        else
-        {
-          draw = 1;
-          skip = (pixLength - pdraw->pixCount) / pdraw->pixCount;
-        }
-
-        //pixelNutSupport.msgFormat(F("Twinkle: draw=%d skip=%d"), draw, skip);
-      }
-
-      float scale = 0.0;
-
-      if (draw)
-      {
-        --draw;
-        //pixelNutSupport.msgFormat(F("Twinkle: pbytes[%d]=%d"), i, pbytes[i]);
-
-        bool doscale = true;
-
-        if (pbytes[i] >= maxvalue)
-        {
-          if (--(pbytes[i]) >= maxvalue)
-            continue; // keep off for now
-
-          pbytes[i] = 1; // draw now, increasing level
-        }
-        else if (++(pbytes[i]) == 0)
-        {
-          pbytes[i] = maxvalue + random(10, 60); // go dark for random time
-          doscale = false;
-        }
-        else if (pbytes[i] == maxvalue)
-          pbytes[i] = -(maxvalue-1); // start decreasing level
-
-        if (doscale) scale = ((float)abs(pbytes[i])) / maxvalue;
-      }
-      else
-      {
-        --skip;
-        //pixelNutSupport.msgFormat(F("Twinkle: skipping #%d"), i);
-      }
-
-      pixelNutSupport.setPixel(handle, i, pdraw->r, pdraw->g, pdraw->b, scale);
-    }
+    pixelNutPhases.phaseSpacing(pdata, pdraw->pixCount);
+    pixelNutPhases.phaseDraw(pdata, pdraw, handle, (4 * PHASE_SPEED_ONE), PixelNutPhases::PhaseRamp_Twinkle);
   }
 
 private:
-  uint16_t pixLength;
-  int16_t *pbytes, maxvalue;
+  PixelNutPhases::phaseData pdata;
 };
@@ -36,57 +36,193 @@
 #include "PNP_WinExpander.h"
 #include "PNP_FlipDirection.h"
 
-// returns true if plugin redraws, else filter
-bool PluginFactory::pluginDraws(uint16_t plugin)
+// Registry of the built-in plugins, sorted by ID. A build that needs only some of them can
+// define its own PLUGINS_BUILTIN list (in config.h), and only those plugins are compiled in.
+
+#if !defined(PLUGINS_BUILTIN)
+#define PLUGINS_BUILTIN(X) \
+  /* drawing effects: */ \
+  X(0,   PNP_DrawAll,       PNP_EBIT_REDRAW | PNP_EBIT_COLOR, \
+    "DrawAll",        "Draws current color to all pixels on each step.") \
+  X(1,   PNP_DrawPush,      PNP_EBIT_REDRAW | PNP_EBIT_COLOR | PNP_EBIT_DELAY | PNP_EBIT_DIRECTION | \
+                            PNP_EBIT_TRIGFORCE | PNP_EBIT_SENDFORCE, \
+    "DrawPush",       "Draws current color to one pixel on each step, inserting at the end, then clearing.") \
+  X(2,   PNP_DrawStep,      PNP_EBIT_REDRAW | PNP_EBIT_COLOR | PNP_EBIT_DELAY | PNP_EBIT_DIRECTION | \
+                            PNP_EBIT_TRIGFORCE | PNP_EBIT_SENDFORCE, \
+    "DrawStep",       "Draws current color to one pixel on each step, appending at the start.") \
+  X(10,  PNP_LightWave,     PNP_EBIT_REDRAW | PNP_EBIT_COLOR | PNP_EBIT_COUNT | PNP_EBIT_DELAY | PNP_EBIT_DIRECTION, \
+    "LightWave",      "Light waves (brightness changes) that move; count sets the wave frequency.") \
+  X(20,  PNP_CometHeads,    PNP_EBIT_REDRAW | PNP_EBIT_COLOR | PNP_EBIT_DELAY | PNP_EBIT_DIRECTION | \
+                            PNP_EBIT_REPTRIGS | PNP_EBIT_SENDFORCE, \
+    "CometHeads",     "Comets with a moving head and a tail that fades; triggering creates a new head.") \
+  X(30,  PNP_FerrisWheel,   PNP_EBIT_REDRAW | PNP_EBIT_COLOR | PNP_EBIT_COUNT | PNP_EBIT_DELAY | PNP_EBIT_DIRECTION, \
+    "FerrisWheel",    "Rotates ferris wheel spokes around; count sets the spaces between spokes.") \
+  X(40,  PNP_BlockScanner,  PNP_EBIT_REDRAW | PNP_EBIT_COLOR | PNP_EBIT_COUNT | PNP_EBIT_DELAY | \
+                            PNP_EBIT_TRIGFORCE | PNP_EBIT_SENDFORCE, \
+    "BlockScanner",   "Moves a block of color back and forth; count sets the block length.") \
+  X(50,  PNP_Twinkle,       PNP_EBIT_REDRAW | PNP_EBIT_COLOR | PNP_EBIT_COUNT | PNP_EBIT_DELAY, \
+    "Twinkle",        "Scales the brightness of 'count' pixels up and down individually.") \
+  X(51,  PNP_Blinky,        PNP_EBIT_REDRAW | PNP_EBIT_COLOR | PNP_EBIT_COUNT | PNP_EBIT_DELAY, \
+    "Blinky",         "Blinks 'count' random pixels on and off.") \
+  X(52,  PNP_Noise,         PNP_EBIT_REDRAW | PNP_EBIT_COLOR | PNP_EBIT_COUNT | PNP_EBIT_DELAY, \
+    "Noise",          "Sets 'count' random pixels to random brightness levels.") \
+  /* predraw effects: */ \
+  X(100, PNP_HueSet,        PNP_EBIT_TRIGFORCE | PNP_EBIT_ORIDE_HUE, \
+    "HueSet",         "Force directly sets the color hue once when triggered.") \
+  X(101, PNP_HueRotate,     PNP_EBIT_TRIGFORCE | PNP_EBIT_ORIDE_HUE, \
+    "HueRotate",      "Rotates the color hue on each step; force sets the amount of change.") \
+  X(110, PNP_ColorMeld,     PNP_EBIT_SENDFORCE | PNP_EBIT_ORIDE_HUE | PNP_EBIT_ORIDE_WHITE, \
+    "ColorMeld",      "Smoothly melds between colors when they change.") \
+  X(111, PNP_ColorModify,   PNP_EBIT_TRIGFORCE | PNP_EBIT_ORIDE_HUE | PNP_EBIT_ORIDE_WHITE, \
+    "ColorModify",    "Force modifies the color hue and whiteness once when triggered.") \
+  X(112, PNP_ColorRandom,   PNP_EBIT_DELAY | PNP_EBIT_ORIDE_HUE | PNP_EBIT_ORIDE_WHITE, \
+    "ColorRandom",    "Sets the color hue and whiteness to random values on each step.") \
+  X(120, PNP_CountSet,      PNP_EBIT_TRIGFORCE | PNP_EBIT_ORIDE_COUNT, \
+    "CountSet",       "Force directly sets the count once when triggered.") \
+  X(121, PNP_CountSurge,    PNP_EBIT_TRIGFORCE | PNP_EBIT_ORIDE_COUNT, \
+    "CountSurge",     "Force increases the count, which then evenly reverts to its original value.") \
+  X(122, PNP_CountWave,     PNP_EBIT_TRIGFORCE | PNP_EBIT_SENDFORCE | PNP_EBIT_ORIDE_COUNT, \
+    "CountWave",      "Modulates the count; force sets the number of steps.") \
+  X(130, PNP_DelaySet,      PNP_EBIT_TRIGFORCE | PNP_EBIT_ORIDE_DELAY, \
+    "DelaySet",       "Force directly sets the delay once when triggered.") \
+  X(131, PNP_DelaySurge,    PNP_EBIT_TRIGFORCE | PNP_EBIT_ORIDE_DELAY, \
+    "DelaySurge",     "Force decreases the delay, which then reverts to its original value.") \
+  X(132, PNP_DelayWave,     PNP_EBIT_TRIGFORCE | PNP_EBIT_SENDFORCE | PNP_EBIT_ORIDE_DELAY, \
+    "DelayWave",      "Modulates the delay; force sets the number of steps.") \
+  X(141, PNP_BrightSurge,   PNP_EBIT_TRIGFORCE, \
+    "BrightSurge",    "Force increases the brightness, which then reverts to its original value.") \
+  X(142, PNP_BrightWave,    PNP_EBIT_TRIGFORCE | PNP_EBIT_SENDFORCE, \
+    "BrightWave",     "Modulates the brightness; force sets the number of steps.") \
+  X(150, PNP_WinExpander,   PNP_EBIT_TRIGFORCE | PNP_EBIT_SENDFORCE | PNP_EBIT_ORIDE_EXT, \
+    "WinExpander",    "Expands and contracts the drawing window, which stays centered on the strip.") \
+  X(160, PNP_FlipDirection, PNP_EBIT_ORIDE_DIR, \
+    "FlipDirection",  "Toggles the drawing direction on each trigger.")
+#endif
+
+PLUGINS_BUILTIN(PLUGIN_STRINGS)
+
+static constexpr PROGMEM PluginEntry builtinPlugins[] =
+{
+  PLUGINS_BUILTIN(PLUGIN_ENTRY)
+};
+
+#define NUM_BUILTIN_PLUGINS (sizeof(builtinPlugins) / sizeof(PluginEntry))
+
+static_assert(PluginsInOrder(builtinPlugins, NUM_BUILTIN_PLUGINS), "Built-in plugins must be sorted by ID");
+
+// binary search of a registry table for a plugin, copying out its entry if found
+static bool FindEntry(const PluginEntry *ptable, int count, uint16_t plugin, PluginEntry *pentry)
 {
-  return (plugin < 100);
+  int lo = 0;
+  int hi = count-1;
+
+  while (lo <= hi)
+  {
+    int mid = (lo + hi) / 2;
+    uint16_t id = pgm_read_word(&ptable[mid].id);
+
+    if (id == plugin)
+    {
+      memcpy_P(pentry, &ptable[mid], sizeof(PluginEntry));
+      return true;
+    }
+
+    if (id < plugin) lo = mid+1;
+    else             hi = mid-1;
+  }
+
+  return false;
 }
 
-PixelNutPlugin *PluginFactory::pluginCreate(uint16_t plugin)
+// device plugins can't have the IDs of built-in ones, as those are called directly as the
+// built-in classes (see pluginStep below)
+PluginFactory::PluginFactory(const PluginEntry *ptable, byte count)
 {
-  switch (plugin)
+  pDevTable = ptable;
+  numDevPlugins = count;
+
+  PluginEntry entry;
+  for (int i = 0; i < count; ++i)
   {
-    // drawing effects:
+    if (FindEntry(builtinPlugins, NUM_BUILTIN_PLUGINS, pgm_read_word(&ptable[i].id), &entry))
+    {
+      DBGOUT((F("Device plugin #%d is also built-in: no device plugins"), entry.id));
+      numDevPlugins = 0;
+      break;
+    }
+  }
+}
 
-    case 0:   return new PNP_DrawAll;                     // draws current color to all pixels on each step
-    case 1:   return new PNP_DrawPush;                    // draws current color to one pixel on each step, inserting at the end, then clearing
-    case 2:   return new PNP_DrawStep;                    // draws current color to one pixel on each step, appending at the start
+void PluginFactory::deviceEntry(byte index, PluginEntry *pentry)
+{
+  memcpy_P(pentry, &pDevTable[index], sizeof(PluginEntry));
+}
 
-    case 10:  return new PNP_LightWave;                   // light waves (brighness changes) that move; count property sets wave frequency
-    case 20:  return new PNP_CometHeads;                  // creates "comets": moving head with tail that fades, trigger creates new head
-    case 30:  return new PNP_FerrisWheel;                 // rotates "ferris wheel spokes" around; count property sets spaces between spokes
-    case 40:  return new PNP_BlockScanner;                // moves color block back and forth; count property sets the block length 
+bool PluginFactory::pluginEntry(uint16_t plugin, PluginEntry *pentry)
+{
+  return FindEntry(pDevTable, numDevPlugins, plugin, pentry) ||
+         FindEntry(builtinPlugins, NUM_BUILTIN_PLUGINS, plugin, pentry);
+}
 
-                                                          // these use the current color, and count property sets the value of 'N':
-    case 50:  return new PNP_Twinkle;                     // scales the brightness levels for 'N' pixels up and down individually
-    case 51:  return new PNP_Blinky;                      // blinks 'N' random pixels on/off using current color and brightness
-    case 52:  return new PNP_Noise;                       // sets 'N' random pixels using current color and random brightness 
+uint16_t PluginFactory::pluginBits(uint16_t plugin)
+{
+  PluginEntry entry;
+  return pluginEntry(plugin, &entry) ? entry.bits : 0;
+}
 
-    // predraw effects:
+uint16_t PluginFactory::pluginSize(uint16_t plugin)
+{
+  PluginEntry entry;
+  return pluginEntry(plugin, &entry) ? entry.size : 0;
+}
 
-    case 100: return new PNP_HueSet;                      // force directly sets the color hue property value once when triggered
-    case 101: return new PNP_HueRotate;                   // rotates color hue on each step; amount of change set from trigger force
+bool PluginFactory::pluginDraws(uint16_t plugin)
+{
+  return (pluginBits(plugin) & PNP_EBIT_REDRAW);
+}
 
-    case 110: return new PNP_ColorMeld;                   // smoothly melds between colors when they change
-    case 111: return new PNP_ColorModify;                 // force modifies both the color hue/white properties once when triggered
-    case 112: return new PNP_ColorRandom;                 // sets color hue/white to random values on each step (doesn't use force)
-    
-    case 120: return new PNP_CountSet;                    // force directly sets the count property value once when triggered
-    case 121: return new PNP_CountSurge;                  // force increases count then evenly reverts to original value
-    case 122: return new PNP_CountWave;                   // force determines the number of steps that modulates pixel count
+PixelNutPlugin *PluginFactory::pluginCreate(uint16_t plugin)
+{
+  PluginEntry entry;
+  return pluginEntry(plugin, &entry) ? entry.create() : NULL;
+}
 
-    case 130: return new PNP_DelaySet;                    // force directly sets the delay property value once when triggered
-    case 131: return new PNP_DelaySurge;                  // force decreases delay then reverts to original value, must be triggered
-    case 132: return new PNP_DelayWave;                   // force determines the number of steps that modulates delay time
+// qualified calls: these are not virtual, so can be inlined into the switches below
+template <class T> static inline void StepPlugin(PixelNutPlugin *pPlugin,
+                        PixelNutHandle handle, PixelNutSupport::DrawProps *pdraw)
+{
+  static_cast<T*>(pPlugin)->T::nextstep(handle, pdraw);
+}
 
-    case 141: return new PNP_BrightSurge;                 // force increases brightness, then reverts to original value, must be triggered
-    case 142: return new PNP_BrightWave;                  // force determines the number of steps that modulates brightness
+template <class T> static inline void TriggerPlugin(PixelNutPlugin *pPlugin,
+                        PixelNutHandle handle, PixelNutSupport::DrawProps *pdraw, byte force)
+{
+  static_cast<T*>(pPlugin)->T::trigger(handle, pdraw, force);
+}
+
+#define PLUGIN_STEP_CASE(id, cls, bits, name, desc) \
+  case id: StepPlugin<cls>(pPlugin, handle, pdraw); break;
 
-    case 150: return new PNP_WinExpander;                 // expands/contracts drawing window that stays centered on strip
+#define PLUGIN_TRIGGER_CASE(id, cls, bits, name, desc) \
+  case id: TriggerPlugin<cls>(pPlugin, handle, pdraw, force); break;
 
-    case 160: return new PNP_FlipDirection;               // toggles the drawing direction on each trigger
+void PluginFactory::pluginStep(uint16_t plugin, PixelNutPlugin *pPlugin,
+                               PixelNutHandle handle, PixelNutSupport::DrawProps *pdraw)
+{
+  switch (plugin)
+  {
+    PLUGINS_BUILTIN(PLUGIN_STEP_CASE)
+    default:  pPlugin->nextstep(handle, pdraw); break;
+  }
+}
 
-    default:  return NULL;
+void PluginFactory::pluginTrigger(uint16_t plugin, PixelNutPlugin *pPlugin,
+                                  PixelNutHandle handle, PixelNutSupport::DrawProps *pdraw, byte force)
+{
+  switch (plugin)
+  {
+    PLUGINS_BUILTIN(PLUGIN_TRIGGER_CASE)
+    default:  pPlugin->trigger(handle, pdraw, force); break;
   }
 }
 
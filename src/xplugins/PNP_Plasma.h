@@ -18,7 +18,7 @@
 //
 // Calling nextstep():
 //
-//    Draws some pixels.
+//    Draws all the pixels, a row at a time (as laid out in a matrix, else a square is assumed).
 //
 // Properties Used:
 //
@@ -48,11 +48,13 @@ public:
   {
     phase = 0.0;
     pixLength = pixlen;
-    numrows = numcols = (uint16_t)sqrt(pixlen);
-    while ((numrows * numcols) < pixlen) ++numcols;
-    if (numcols > numrows) --numcols; // back off one if did increment
-    endcol = numcols + (pixlen - (numcols * numrows));
-    //DBGOUT((F("Plasma: pixs=%d rows=%d cols=%d endcol=%d"), pixlen, numrows, numcols, endcol));
+
+    // without a layout for the pixels, guess they're a square matrix
+    guessrows = guesscols = (uint16_t)sqrt(pixlen);
+    while ((guessrows * guesscols) < pixlen) ++guesscols;
+    if (guesscols > guessrows) --guesscols; // back off one if did increment
+    endcol = guesscols + (pixlen - (guesscols * guessrows));
+    //DBGOUT((F("Plasma: pixs=%d rows=%d cols=%d endcol=%d"), pixlen, guessrows, guesscols, endcol));
   }
 
   void nextstep(PixelNutHandle handle, PixelNutSupport::DrawProps *pdraw)
@@ -62,59 +64,79 @@ public:
     phase += pinc;
     //DBGOUT((F("Plasma: pcent=%d phase=%.4f pinc=%.4f"), pcent, phase, pinc));
 
-    Point p1 = { static_cast<float>(((sin(phase * 1.000)+1.0)/2.0)*(numrows-1)), static_cast<float>(((sin(phase * 1.310)+1.0)/2.0)*(numcols-1)) };
-    Point p2 = { static_cast<float>(((sin(phase * 1.770)+1.0)/2.0)*(numrows-1)), static_cast<float>(((sin(phase * 2.865)+1.0)/2.0)*(numcols-1)) };
-    Point p3 = { static_cast<float>(((sin(phase * 0.250)+1.0)/2.0)*(numrows-1)), static_cast<float>(((sin(phase * 0.750)+1.0)/2.0)*(numcols-1)) };
+    bool matrix = (pixelNutSupport.layoutHeight(handle) > 1);
+    uint16_t numrows = matrix ? pixelNutSupport.layoutHeight(handle) : guessrows;
+    uint16_t numcols = matrix ? pixelNutSupport.layoutWidth(handle)  : guesscols;
+    uint16_t rowlen  = matrix ? numcols : endcol;
+
+    Point p1 = { static_cast<float>(((sin(phase * 1.000)+1.0)/2.0)*(numcols-1)), static_cast<float>(((sin(phase * 1.310)+1.0)/2.0)*(numrows-1)) };
+    Point p2 = { static_cast<float>(((sin(phase * 1.770)+1.0)/2.0)*(numcols-1)), static_cast<float>(((sin(phase * 2.865)+1.0)/2.0)*(numrows-1)) };
+    Point p3 = { static_cast<float>(((sin(phase * 0.250)+1.0)/2.0)*(numcols-1)), static_cast<float>(((sin(phase * 0.750)+1.0)/2.0)*(numrows-1)) };
 
     //DBGOUT((F("Plasma: P1: %d.%d"), (int)p1.x, (int)p1.y));
     //DBGOUT((F("Plasma: P2: %d.%d"), (int)p2.x, (int)p2.y));
     //DBGOUT((F("Plasma: P3: %d.%d"), (int)p3.x, (int)p3.y));
 
+    byte rgb[SPAN_CHUNK_PIXELS * 3];
+
     for (uint16_t row = 0; row < numrows; ++row)
     {
       float row_f = float(row);
-      
-      for (uint16_t col = 0; col < endcol; ++col)
+
+      for (uint16_t col = 0; col < rowlen; ) // compose and copy a chunk of each row at a time
       {
-        float col_f = float(col);
-
-        // Calculate the distance between this LED, and p1.
-        Point dist1 = { col_f - p1.x, row_f - p1.y };  // The vector from p1 to this LED.
-        float distance1 = sqrt(dist1.x * dist1.x + dist1.y * dist1.y);
-
-        // Calculate the distance between this LED, and p2.
-        Point dist2 = { col_f - p2.x, row_f - p2.y };  // The vector from p2 to this LED.
-        float distance2 = sqrt(dist2.x * dist2.x + dist2.y * dist2.y);
-
-        // Calculate the distance between this LED, and p3.
-        Point dist3 = { col_f - p3.x, row_f - p3.y };  // The vector from p3 to this LED.
-        float distance3 = sqrt(dist3.x * dist3.x + dist3.y * dist3.y);
-
-        //DBGOUT((F("Plasma: distances(%.4f %.4f %.4f)"), distance1, distance2, distance3));
-
-        // Warp the distance with a sin() function. As the distance value increases, the LEDs will get light,dark,light,dark...
-        float color_1 = distance1;  // range: 0.0...1.0
-        float color_2 = distance2;
-        float color_3 = distance3;
-        float color_4 = (sin(distance1 * distance2 * COLOR_STRETCH)) + 1.0;
-        //DBGOUT((F("Plasma: colors(%.4f %.4f %.4f %.4f)"), color_1, color_2, color_3, color_4));
-
-        // Square the color_f value to weight it towards 0. The image will be darker and have higher contrast.
-        color_1 *= color_1 * color_4;
-        color_2 *= color_2 * color_4;
-        color_3 *= color_3 * color_4;
-        color_4 *= color_4;
-        //DBGOUT((F("Plasma: colors(%.4f %.4f %.4f %.4f)"), color_1, color_2, color_3, color_4));
-
-        //DBGOUT((F("Plasma: pos=%d color=%d.%d.%d"), col + (numcols * row), (byte)color_1, (byte)color_2, (byte)color_3));
-        pixelNutSupport.setPixel(handle, col + (numcols * row), (byte)color_1, (byte)color_2, (byte)color_3);
+        uint16_t count = rowlen - col;
+        if (count > SPAN_CHUNK_PIXELS) count = SPAN_CHUNK_PIXELS;
+
+        byte *prgb = rgb;
+        for (uint16_t j = 0; j < count; ++j)
+        {
+          float col_f = float(col + j);
+
+          // Calculate the distance between this LED, and p1.
+          Point dist1 = { col_f - p1.x, row_f - p1.y };  // The vector from p1 to this LED.
+          float distance1 = sqrt(dist1.x * dist1.x + dist1.y * dist1.y);
+
+          // Calculate the distance between this LED, and p2.
+          Point dist2 = { col_f - p2.x, row_f - p2.y };  // The vector from p2 to this LED.
+          float distance2 = sqrt(dist2.x * dist2.x + dist2.y * dist2.y);
+
+          // Calculate the distance between this LED, and p3.
+          Point dist3 = { col_f - p3.x, row_f - p3.y };  // The vector from p3 to this LED.
+          float distance3 = sqrt(dist3.x * dist3.x + dist3.y * dist3.y);
+
+          //DBGOUT((F("Plasma: distances(%.4f %.4f %.4f)"), distance1, distance2, distance3));
+
+          // Warp the distance with a sin() function. As the distance value increases, the LEDs will get light,dark,light,dark...
+          float color_1 = distance1;  // range: 0.0...1.0
+          float color_2 = distance2;
+          float color_3 = distance3;
+          float color_4 = (sin(distance1 * distance2 * COLOR_STRETCH)) + 1.0;
+          //DBGOUT((F("Plasma: colors(%.4f %.4f %.4f %.4f)"), color_1, color_2, color_3, color_4));
+
+          // Square the color_f value to weight it towards 0. The image will be darker and have higher contrast.
+          color_1 *= color_1 * color_4;
+          color_2 *= color_2 * color_4;
+          color_3 *= color_3 * color_4;
+          color_4 *= color_4;
+          //DBGOUT((F("Plasma: colors(%.4f %.4f %.4f %.4f)"), color_1, color_2, color_3, color_4));
+
+          *prgb++ = (byte)color_1;
+          *prgb++ = (byte)color_2;
+          *prgb++ = (byte)color_3;
+        }
+
+        //DBGOUT((F("Plasma: row=%d col=%d count=%d"), row, col, count));
+        if (matrix) pixelNutSupport.copyRowPixels(handle, row, col, count, rgb);
+        else pixelNutSupport.copyPixels(handle, (col + (numcols * row)), count, rgb);
+        col += count;
       }
     }
   }
 
 private:
   uint16_t pixLength;
-  uint16_t numrows, numcols, endcol;
+  uint16_t guessrows, guesscols, endcol;
   float phase;
 };
 
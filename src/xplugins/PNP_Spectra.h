@@ -5,151 +5,233 @@
 //*********************************************************************************************
 // What Effect Does:
 //
+//    Draws the intensities of the frequency bands of the audio input as bars up each column of
+//    a matrix (see PIXEL_LAYOUTS), or if the pixels aren't laid out as one, as the brightness
+//    of each pixel.
+//
 // Calling trigger():
 //
+//    Not instantiated.
+//
 // Calling nextstep():
 //
+//    Draws the latest analysis from the shared audio bus (if it has changed).
+//
 // Properties Used:
 //
 //    none
 //
 // Properties Affected:
 //
-//    r,g,b - the raw pixel values
+//    none
 //
 #if PLUGIN_SPECTRA
 
-#include "freqfft.h"
+#include "audiobus.h"
 
-#if !defined(MATRIX_STRIDE)
-#define MATRIX_STRIDE 2 // FIXME
-#endif
+#define SPECTRA_BAR_HUE     25  // hue of the cell at the bottom of each bar
+#define SPECTRA_BAR_STEP    4   // added to the hue for each cell up the bar
+#define SPECTRA_TOP_HUE     50  // yellowish cell at the top of each bar
+#define SPECTRA_FIRST_HUE   320 // hue of the first pixel when not a matrix
 
-#define SAMPLE_RATE_HZ          2000    // Sample rate of the audio in hertz
-#define SPECTRUM_MIN_DB         40.0    // intensity (in decibels) that maps to low LED brightness
-#define SPECTRUM_MAX_DB         80.0    // intensity (in decibels) that maps to high LED brightness
+// The colors are fixed for each position, so they are calculated once (at full brightness)
+// for the layout of the pixels, along with the gamma corrected brightness for each percentage.
+// Drawing then only looks up the colors and scales them, composing a chunk of a row at a time
+// that is then copied all together.
 
-#if (MATRIX_STRIDE > 1)
-uint16_t* hueVals = NULL;
-#endif
-
-PixelNutHandle theHandle;
-PixelNutSupport::DrawProps *thePdraw;
-
-static void Spectra_SetPixel(int pos, float value)
+class PNP_Spectra : public PixelNutPlugin
 {
-  //pixelNutSupport.msgFormat(F("Spectra: pos=%d value=%.2f"), pos, value);
-
-  thePdraw->pcentWhite = 0;
+public:
 
-  #if (MATRIX_STRIDE > 1)
+  void begin(uint16_t id, uint16_t pixlen)
+  {
+    lastFrame = 0;
+    numCols = numRows = 0;
+    colorVals = NULL;
+    barVals = NULL;
 
-  int pix = pos * MATRIX_STRIDE;
-  float last = (MATRIX_STRIDE * value);
-  int index = (int)last;
-  value = last - (float)index;
-  if (!(pos & 1)) index = MATRIX_STRIDE - index;
+    subscribed = AudioBus_Subscribe();
+    if (!subscribed) return;
 
-  //pixelNutSupport.msgFormat(F("Spectra: pix=%d last=%.2f index=%d value=%.2f"), pix, last, index, value);
+    for (int i = 0; i <= MAX_PERCENTAGE; ++i)
+      levelVals[i] = pixelNutSupport.gammaCorrect((i * MAX_PIXEL_VALUE) / MAX_PERCENTAGE);
+  }
 
-  for (int i = 0; i < index; ++i)
+  ~PNP_Spectra()
   {
-    thePdraw->dvalueHue = (pos & 1) ? 25+(i*4) : 0;
-    thePdraw->pcentBright = (pos & 1) ? 100 : 0;
-    pixelNutSupport.makeColorVals(thePdraw);
-    pixelNutSupport.setPixel(theHandle, pix+i, thePdraw->r, thePdraw->g, thePdraw->b);
-
-    //pixelNutSupport.msgFormat(F("Spectra: %d+%d <= %d"), pix, i, thePdraw->pcentBright);
+    if (subscribed)
+    {
+      free(colorVals);
+      free(barVals);
+      AudioBus_Unsubscribe();
+    }
   }
 
-  thePdraw->dvalueHue = 50; // yellowish
-  thePdraw->pcentBright = (value * 100);
-  pixelNutSupport.makeColorVals(thePdraw);
-  pixelNutSupport.setPixel(theHandle, pix+index, thePdraw->r, thePdraw->g, thePdraw->b);
-
-  //pixelNutSupport.msgFormat(F("Spectra: %d+%d <= %d"), pix, index, thePdraw->pcentBright);
-
-  for (int i = index+1; i < MATRIX_STRIDE; ++i)
+  void nextstep(PixelNutHandle handle, PixelNutSupport::DrawProps *pdraw)
   {
-    thePdraw->dvalueHue = (pos & 1) ? 0 : 25+((MATRIX_STRIDE-i)*4);
-    thePdraw->pcentBright = (pos & 1) ? 0 : 100;
-    pixelNutSupport.makeColorVals(thePdraw);
-    pixelNutSupport.setPixel(theHandle, pix+i, thePdraw->r, thePdraw->g, thePdraw->b);
+    if (!subscribed) return;
 
-    //pixelNutSupport.msgFormat(F("Spectra: %d+%d <= %d"), pix, i, thePdraw->pcentBright);
-  }
+    // the layout is only known once drawing
+    if ((numCols != pixelNutSupport.layoutWidth(handle)) ||
+        (numRows != pixelNutSupport.layoutHeight(handle)))
+      MakeColors(handle);
 
-  #else
-  thePdraw->dvalueHue = hueVals[pos];
-  thePdraw->pcentBright = (value * 100);
-  pixelNutSupport.makeColorVals(thePdraw);
-  pixelNutSupport.setPixel(theHandle, pos, thePdraw->r, thePdraw->g, thePdraw->b);
-  #endif
-}
+    if ((colorVals == NULL) || ((numRows > 1) && (barVals == NULL))) return;
 
-class PNP_Spectra : public PixelNutPlugin
-{
-public:
+    // analysis is shared: draw only when there's a new snapshot
+    AudioSnapshot snap;
+    AudioBus_Update();
+    uint32_t frame = AudioBus_Read(&snap);
+    if (frame == lastFrame) return;
+    lastFrame = frame;
 
-  void begin(uint16_t id, uint16_t pixlen)
-  {
-    #if (MATRIX_STRIDE > 1)
-    pixlen /= MATRIX_STRIDE;
-    #endif
+    byte rgb[SPAN_CHUNK_PIXELS * 3];
 
-    if (FreqFFT_Init(SAMPLE_RATE_HZ, pixlen))
+    if (numRows > 1)
     {
-      pinMode(APIN_MICROPHONE, INPUT);
+      // the cells lit in each bar (and how bright the one at the top of them is)
+      for (int i = 0; i < numCols; ++i)
+      {
+        float value = (numRows * AudioBus_Band(&snap, i, numCols));
+        int cells = (int)value;
+        if (cells >= numRows) cells = numRows-1;
+
+        barVals[i].cells = cells;
+        barVals[i].level = levelVals[(int)((value - cells) * MAX_PERCENTAGE)];
+      }
 
-      #if (MATRIX_STRIDE > 1)
-      hueVals = (uint16_t*)malloc(pixlen * sizeof(uint16_t));
-      if (hueVals != NULL)
+      for (uint16_t row = 0; row < numRows; ++row) // bars go up from the bottom row
       {
-        // evenly spread hues across all pixels, starting with red
-        // TODO: set manually for better color separation
-        float inc = (float)MAX_DVALUE_HUE / (float)pixlen;
-        float hue = 320.0;
+        uint16_t cell = (numRows-1) - row;
+        const byte *pcolor = colorVals + (cell * 3);
 
-        for (int i = 0; i < pixlen; ++i)
+        for (uint16_t i = 0; i < numCols; ) // compose and copy a chunk of the row at a time
         {
-          //pixelNutSupport.msgFormat(F("Spectra: %d) hue=%d"), i, (uint16_t)hue);
-          hueVals[i] = (uint16_t)hue;
-          hue += inc;
-          if (hue > MAX_DVALUE_HUE) hue = 0.0;
+          uint16_t count = numCols - i;
+          if (count > SPAN_CHUNK_PIXELS) count = SPAN_CHUNK_PIXELS;
+
+          byte *prgb = rgb;
+          for (uint16_t j = 0; j < count; ++j, prgb += 3)
+          {
+            BarValue *pbar = barVals + i + j;
+            if (cell < pbar->cells) memcpy(prgb, pcolor, 3);
+            else if (cell == pbar->cells) ScaleColor(prgb, topColor, pbar->level);
+            else memset(prgb, 0, 3);
+          }
+
+          pixelNutSupport.copyRowPixels(handle, row, i, count, rgb);
+          i += count;
         }
       }
-      else FreqFFT_Fini();
-      #endif
+    }
+    else
+    {
+      for (uint16_t i = 0; i < numCols; ) // compose and copy a chunk of pixels at a time
+      {
+        uint16_t count = numCols - i;
+        if (count > SPAN_CHUNK_PIXELS) count = SPAN_CHUNK_PIXELS;
+
+        byte *prgb = rgb;
+        for (uint16_t j = 0; j < count; ++j, prgb += 3)
+        {
+          byte level = levelVals[(int)(AudioBus_Band(&snap, i+j, numCols) * MAX_PERCENTAGE)];
+          ScaleColor(prgb, colorVals + ((i+j) * 3), level);
+        }
+
+        pixelNutSupport.copyPixels(handle, i, count, rgb);
+        i += count;
+      }
     }
   }
 
-  ~PNP_Spectra()
+private:
+  typedef struct
   {
-    if (hueVals != NULL)
-    {
-      free(hueVals);
-      hueVals = NULL;
-      FreqFFT_Fini();
-    }
+    uint16_t cells;                     // cells fully lit
+    byte level;                         // gamma corrected brightness of the one above
   }
+  BarValue;
+
+  bool subscribed;
+  uint32_t lastFrame;
+  uint16_t numCols, numRows;            // of the layout: one band for each column
 
-  void trigger(PixelNutHandle handle, PixelNutSupport::DrawProps *pdraw, byte force)
+  byte *colorVals;                      // colors at full brightness for each cell up the bars,
+                                        // or else each pixel
+  BarValue *barVals;                    // for each bar while drawing them
+  byte topColor[3];
+  byte levelVals[MAX_PERCENTAGE+1];     // gamma corrected brightness for each percentage
+
+  void SetColor(byte *prgb, PixelNutSupport::DrawProps *pdraw)
   {
-    if (hueVals != NULL)
-    {
-      theHandle = handle;
-      thePdraw = pdraw;
+    prgb[0] = pdraw->r;
+    prgb[1] = pdraw->g;
+    prgb[2] = pdraw->b;
+  }
 
-      int min = SPECTRUM_MIN_DB;
-      int max = SPECTRUM_MAX_DB;
-      // TODO: use force to determine these
-      FreqFFT_Begin(min, max);
-    }
+  // same as the color calculated at that brightness, since gamma correction is a power curve
+  void ScaleColor(byte *prgb, const byte *pcolor, byte level)
+  {
+    prgb[0] = (pcolor[0] * level) / MAX_PIXEL_VALUE;
+    prgb[1] = (pcolor[1] * level) / MAX_PIXEL_VALUE;
+    prgb[2] = (pcolor[2] * level) / MAX_PIXEL_VALUE;
   }
 
-  void nextstep(PixelNutHandle handle, PixelNutSupport::DrawProps *pdraw)
+  // Calculates the colors for the layout: bars up the columns of a matrix, or if the pixels
+  // are a single row, each pixel is a band with its own hue.
+  void MakeColors(PixelNutHandle handle)
   {
-    if (hueVals != NULL) FreqFFT_Next(Spectra_SetPixel);
+    numCols = pixelNutSupport.layoutWidth(handle);
+    numRows = pixelNutSupport.layoutHeight(handle);
+
+    free(colorVals);
+    free(barVals);
+    barVals = NULL;
+
+    if (numRows > 1)
+    {
+      colorVals = (byte*)malloc(numRows * 3);
+      barVals = (BarValue*)malloc(numCols * sizeof(BarValue));
+    }
+    else colorVals = (byte*)malloc(numCols * 3);
+    if ((colorVals == NULL) || ((numRows > 1) && (barVals == NULL))) return;
+
+    PixelNutSupport::DrawProps props;
+    props.pcentWhite = 0;
+    props.pcentBright = MAX_PERCENTAGE;
+
+    if (numRows > 1)
+    {
+      // ramp of colors up each bar, from the bottom cell
+      for (int i = 0; i < numRows; ++i)
+      {
+        props.dvalueHue = SPECTRA_BAR_HUE + (i * SPECTRA_BAR_STEP);
+        pixelNutSupport.makeColorVals(&props);
+        SetColor(colorVals + (i * 3), &props);
+      }
+
+      props.dvalueHue = SPECTRA_TOP_HUE;
+      pixelNutSupport.makeColorVals(&props);
+      SetColor(topColor, &props);
+    }
+    else
+    {
+      // evenly spread hues across all pixels, starting with red
+      // TODO: set manually for better color separation
+      float inc = (float)MAX_DVALUE_HUE / (float)numCols;
+      float hue = SPECTRA_FIRST_HUE;
+
+      for (int i = 0; i < numCols; ++i)
+      {
+        //pixelNutSupport.msgFormat(F("Spectra: %d) hue=%d"), i, (uint16_t)hue);
+        props.dvalueHue = (uint16_t)hue;
+        pixelNutSupport.makeColorVals(&props);
+        SetColor(colorVals + (i * 3), &props);
+
+        hue += inc;
+        if (hue > MAX_DVALUE_HUE) hue = 0.0;
+      }
+    }
   }
 };
 
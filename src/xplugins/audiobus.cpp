@@ -0,0 +1,217 @@
+// PixelNutApp Audio Analysis Bus Routines
+//========================================================================================
+/*
+Copyright (c) 2021, Greg de Valois
+Software License Agreement (MIT License)
+See license.txt for the terms of this license.
+*/
+// There are two snapshots: the latest one, which is read by the subscribers, and the next
+// one, which is written while the audio is analyzed, then published by advancing the frame
+// counter. Readers don't lock anything (tracks may be rendered in parallel): they just copy
+// the latest one again in the rare case that a new one was published while copying, since
+// the next frame after that is written into the one they were copying.
+
+#include "main.h"
+#include "freqfft.h"
+#include "audioin.h"
+#include "audiobus.h"
+
+#if FREQ_FFT
+
+#define SAMPLE_RATE_HZ          2000    // Sample rate of the audio in hertz
+#define SPECTRUM_MIN_DB         40.0    // intensity (in decibels) that maps to low LED brightness
+#define SPECTRUM_MAX_DB         80.0    // intensity (in decibels) that maps to high LED brightness
+
+#define ONSET_AVERAGE           16      // frames the average and deviation of the flux decay over
+#define ONSET_SENSITIVITY       1.5     // deviations above the average flux for an onset
+#define ONSET_PEAK_DECAY        0.995   // applied to the peak flux every frame (about 3 secs)
+#define ONSET_MIN_FLUX          0.01    // no onsets at less flux than this (silence)
+#define ONSET_MIN_MSECS         100     // shortest time between onsets
+
+#define TEMPO_MIN_BPM           60
+#define TEMPO_MAX_BPM           200
+#define TEMPO_HISTORY           64      // frames of flux kept (must cover the slowest tempo)
+#define TEMPO_DECAY             0.99    // applied to the correlations every frame
+
+static AudioSnapshot snapshots[2];      // latest is at index (frameCount & 1)
+static AudioSnapshot *pNextSnap;        // the other one, while being written
+static uint32_t frameCount;             // number of snapshots published
+static uint32_t blockCount;             // number of blocks captured until the latest one
+static bool producing = false;          // set while a caller is analyzing
+static byte countSubscribers = 0;
+
+static float fluxMean, fluxDev;         // recent average and deviation of the flux
+static float fluxPeak;                  // recent highest flux, for full strength onsets
+static uint32_t onsetMinFrames;         // shortest number of frames between onsets
+static float frameRate;                 // frames per second
+static float fluxHistory[TEMPO_HISTORY]; // flux above the average, for recent frames
+static float tempoCorr[TEMPO_HISTORY];  // correlations of that at each interval (in frames)
+static int tempoMinLag, tempoMaxLag;    // range of intervals for the tempos
+
+static void StartDetection(void)
+{
+  fluxMean = fluxDev = fluxPeak = 0.0;
+  memset(fluxHistory, 0, sizeof(fluxHistory));
+  memset(tempoCorr, 0, sizeof(tempoCorr));
+
+  frameRate = FreqFFT_FrameRate();
+  onsetMinFrames = (uint32_t)((ONSET_MIN_MSECS * frameRate) / 1000) + 1;
+  tempoMinLag = (int)((60 * frameRate) / TEMPO_MAX_BPM);
+  tempoMaxLag = (int)((60 * frameRate) / TEMPO_MIN_BPM);
+  if (tempoMinLag < 1) tempoMinLag = 1;
+  if (tempoMaxLag >= TEMPO_HISTORY) tempoMaxLag = TEMPO_HISTORY-1;
+}
+
+// detects onsets and tempo in a new snapshot (for 'frame'), from the previous one, which
+// was 'skipped' frames before the frame before this one: the frames are the blocks captured,
+// so intervals (and the tempo) are in real time even if some of them weren't analyzed
+static void DetectOnsets(AudioSnapshot *psnap, const AudioSnapshot *pprev, uint32_t frame, int skipped)
+{
+  float flux = 0.0;
+  for (int i = 0; i < AUDIO_BUS_BANDS; ++i)
+  {
+    float diff = psnap->bands[i] - pprev->bands[i];
+    if (diff > 0.0) flux += diff;
+  }
+
+  psnap->flux = flux;
+  psnap->onset = pprev->onset;
+  psnap->onsetFrame = pprev->onsetFrame;
+  psnap->tempo = pprev->tempo;
+
+  // frames skipped have no flux (and this one isn't compared to the one before them),
+  // but the peak and correlations still decay over them
+  if (skipped > TEMPO_HISTORY) skipped = TEMPO_HISTORY;
+
+  float above = flux - fluxMean;
+  if ((above < 0.0) || (skipped > 0)) above = 0.0;
+
+  float decay = TEMPO_DECAY;
+  for (int i = 1; i <= skipped; ++i)
+  {
+    fluxHistory[(frame - i) % TEMPO_HISTORY] = 0.0;
+    fluxPeak *= ONSET_PEAK_DECAY;
+    decay *= TEMPO_DECAY;
+  }
+
+  fluxPeak *= ONSET_PEAK_DECAY;
+  if (flux > fluxPeak) fluxPeak = flux;
+
+  // skip the first frames: there's nothing to compare to yet
+  if ((frame > ONSET_AVERAGE) && (above > 0.0) && (flux > ONSET_MIN_FLUX) &&
+      (above > (ONSET_SENSITIVITY * fluxDev)) &&
+      ((frame - psnap->onsetFrame) >= onsetMinFrames))
+  {
+    float strength = above / (fluxPeak - fluxMean); // can't be 0 if above is not
+    psnap->onset = (strength > 1.0) ? 1.0 : strength;
+    psnap->onsetFrame = frame;
+
+    DBGOUT((F("AudioBus: onset=%.2f frame=%d tempo=%d"), psnap->onset, frame, psnap->tempo));
+  }
+
+  fluxMean += (flux - fluxMean) / ONSET_AVERAGE;
+  fluxDev += (fabs(flux - fluxMean) - fluxDev) / ONSET_AVERAGE;
+
+  fluxHistory[frame % TEMPO_HISTORY] = above;
+
+  int bestlag = 0;
+  float bestcorr = 0.0;
+  for (int lag = tempoMinLag; lag <= tempoMaxLag; ++lag)
+  {
+    float corr = (tempoCorr[lag] * decay) + (above * fluxHistory[(frame - lag) % TEMPO_HISTORY]);
+    tempoCorr[lag] = corr;
+
+    if (corr > bestcorr)
+    {
+      bestcorr = corr;
+      bestlag = lag;
+    }
+  }
+
+  if (bestlag > 0) psnap->tempo = (uint16_t)(((60 * frameRate) / bestlag) + 0.5);
+}
+
+static void AudioBus_SetBand_CB(int pos, float value)
+{
+  pNextSnap->bands[pos] = value;
+  pNextSnap->level += value;
+}
+
+bool AudioBus_Subscribe(void)
+{
+  if (countSubscribers == 0)
+  {
+    if (!FreqFFT_Init(SAMPLE_RATE_HZ, AUDIO_BUS_BANDS)) return false;
+
+    memset(snapshots, 0, sizeof(snapshots));
+    frameCount = 0;
+    blockCount = 0;
+    StartDetection();
+
+    FreqFFT_Begin(SPECTRUM_MIN_DB, SPECTRUM_MAX_DB);
+  }
+
+  ++countSubscribers;
+  DBGOUT((F("AudioBus: subscribers=%d"), countSubscribers));
+  return true;
+}
+
+void AudioBus_Unsubscribe(void)
+{
+  if ((countSubscribers > 0) && (--countSubscribers == 0))
+    FreqFFT_Fini();
+}
+
+bool AudioBus_Update(void)
+{
+  if (countSubscribers == 0) return false;
+  if (__atomic_test_and_set(&producing, __ATOMIC_ACQUIRE)) return false; // someone else is
+
+  // analyze all blocks captured since the last update, so none are skipped if that was
+  // longer ago than a block (at most all of them, in case audio is captured faster)
+  bool done = false;
+  for (int i = 0; i < AUDIO_BLOCKS; ++i)
+  {
+    uint32_t frame = frameCount;
+    pNextSnap = snapshots + ((frame + 1) & 1);
+    pNextSnap->level = 0.0;
+
+    if (!FreqFFT_Next(AudioBus_SetBand_CB)) break;
+
+    int skipped = FreqFFT_Skipped();
+    blockCount += skipped + 1;
+
+    pNextSnap->level /= AUDIO_BUS_BANDS;
+    DetectOnsets(pNextSnap, snapshots + (frame & 1), blockCount, skipped);
+    __atomic_store_n(&frameCount, frame + 1, __ATOMIC_RELEASE);
+    done = true;
+  }
+
+  __atomic_clear(&producing, __ATOMIC_RELEASE);
+  return done;
+}
+
+uint32_t AudioBus_Read(AudioSnapshot *psnap)
+{
+  while (true)
+  {
+    uint32_t frame = __atomic_load_n(&frameCount, __ATOMIC_ACQUIRE);
+    memcpy(psnap, snapshots + (frame & 1), sizeof(AudioSnapshot));
+
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&frameCount, __ATOMIC_RELAXED) == frame) return frame;
+  }
+}
+
+float AudioBus_Band(const AudioSnapshot *psnap, int pos, int count)
+{
+  float band = (((pos + 0.5) * AUDIO_BUS_BANDS) / count) - 0.5;
+  if (band <= 0.0) return psnap->bands[0];
+  if (band >= (AUDIO_BUS_BANDS-1)) return psnap->bands[AUDIO_BUS_BANDS-1];
+
+  int index = (int)band;
+  float frac = band - index;
+  return psnap->bands[index] + ((psnap->bands[index+1] - psnap->bands[index]) * frac);
+}
+
+#endif // FREQ_FFT
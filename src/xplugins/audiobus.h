@@ -0,0 +1,47 @@
+/*
+Copyright (c) 2021, Greg de Valois
+Software License Agreement (MIT License)
+See license.txt for the terms of this license.
+*/
+// Audio analysis shared by all plugins reacting to sound, on any strand: the audio is
+// analyzed once for each block captured, by whichever subscriber updates first, and the
+// results are published as a snapshot that any number of subscribers can read.
+//
+// Onsets (beats, notes) are detected from the spectral flux (the total increase of the
+// bands since the previous frame) rising above its recent average by some number of its
+// recent deviations. The tempo is the interval at which the flux above the average best
+// repeats (autocorrelation), between TEMPO_MIN_BPM and TEMPO_MAX_BPM.
+
+#if FREQ_FFT
+
+#if !defined(AUDIO_BUS_BANDS)
+#define AUDIO_BUS_BANDS         32      // number of frequency bands analyzed
+#endif
+
+typedef struct
+{
+  float level;                          // average intensity of all the bands
+  float flux;                           // spectral flux in this frame
+  float onset;                          // strength of latest onset: 0-1
+  uint32_t onsetFrame;                  // block captured at latest onset (0 if none yet)
+  uint16_t tempo;                       // beats per minute (0 if not known yet)
+  float bands[AUDIO_BUS_BANDS];         // intensity of each band: 0-1, from low to high
+}
+AudioSnapshot;
+
+extern bool AudioBus_Subscribe(void);   // first one starts analysis, false if failed
+extern void AudioBus_Unsubscribe(void); // last one stops it
+
+// Analyzes all the audio captured since the last update if not already done, returning
+// true if a new snapshot was published by this call (the latest of those analyzed: onsets
+// in earlier ones are carried into it). Never waits for other callers.
+extern bool AudioBus_Update(void);
+
+// Copies the latest snapshot, returning its frame number (0 if there hasn't been one yet).
+extern uint32_t AudioBus_Read(AudioSnapshot *psnap);
+
+// Returns intensity at position 'pos' of 'count' spread across the bands, interpolating
+// between the bands if there are more positions than bands.
+extern float AudioBus_Band(const AudioSnapshot *psnap, int pos, int count);
+
+#endif // FREQ_FFT
@@ -0,0 +1,348 @@
+// PixelNutApp Audio Input Routines
+//========================================================================================
+/*
+Copyright (c) 2021, Greg de Valois
+Software License Agreement (MIT License)
+See license.txt for the terms of this license.
+*/
+// Audio sources on the device:
+//
+// AudioSourceADC: microphone on an analog pin (APIN_MICROPHONE). On the ESP32 the ADC is read
+//    by the I2S peripheral into DMA buffers, which are copied out when asked for the next block
+//    (the microphone must be on an ADC1 pin: GPIO 32-39). Else a timer interrupt reads a single
+//    ADC value for each sample, which takes the same (short) time for every sample.
+//
+// AudioSourceI2S: I2S microphone on the ESP32 (DPIN_I2S_MIC_SCK/WS/SD), such as the INMP441.
+//    These need a higher sample rate than is used here, so the samples read from the DMA
+//    buffers are averaged down to the requested rate.
+//
+// Host builds have no source until one is set with AudioIn_SetSource() (see host/AudioStream).
+//
+// The blocks filled are kept in a ring until used, so that all of them can be analyzed even
+// if that's done less often than they're filled: only once the ring is full is the oldest
+// one overwritten (and counted as an overrun). The counts of blocks filled and used are
+// each changed on only one side, so an interrupt can fill them while others are used.
+
+#include "main.h"
+#include "audioin.h"
+
+#if FREQ_FFT
+
+#if defined(ESP32)
+#include <driver/i2s.h>
+#define I2S_PORT                I2S_NUM_0
+#define I2S_DMA_BUFFS           4       // number of DMA buffers
+#endif
+
+bool AudioSource::alloc(uint16_t count)
+{
+  release();
+
+  blocks = (int16_t*)malloc(AUDIO_BLOCKS * count * sizeof(int16_t));
+  if (blocks == NULL) return false;
+
+  blockLen = count;
+  fillBlocks = 0;
+  fillCount = 0;
+  readBlocks = 0;
+  overruns = 0;
+  return true;
+}
+
+void AudioSource::release(void)
+{
+  if (blocks != NULL)
+  {
+    free(blocks);
+    blocks = NULL;
+  }
+}
+
+// switches to the next block when this one is full (may be called from interrupts)
+void AudioSource::filled(uint16_t count)
+{
+  fillCount += count;
+  if (fillCount >= blockLen)
+  {
+    fillCount = 0;
+    ++fillBlocks;
+  }
+}
+
+// the block being filled has overwritten the oldest one if all the others are ready
+const int16_t *AudioSource::takeReady(void)
+{
+  uint16_t count = fillBlocks;
+  uint16_t ready = count - readBlocks;
+  if (ready == 0) return NULL;
+
+  if (ready >= AUDIO_BLOCKS)
+  {
+    overruns += ready - (AUDIO_BLOCKS-1);
+    readBlocks = count - (AUDIO_BLOCKS-1);
+  }
+
+  return blocks + ((readBlocks++ % AUDIO_BLOCKS) * blockLen);
+}
+
+#if !HOST_BUILD && defined(APIN_MICROPHONE)
+
+#if defined(ESP32)
+#define ANALOG_READ_RESOLUTION  12      // Bits of resolution for the ADC (fixed for I2S)
+#else
+#define ANALOG_READ_RESOLUTION  10      // Bits of resolution for the ADC
+#define ANALOG_READ_AVERAGING   16      // Number of samples to average with each ADC reading
+#endif
+
+// converts ADC values to Q15 samples
+#define ADC_TO_SAMPLE(v)        (int16_t)(((int)(v) - (1 << (ANALOG_READ_RESOLUTION-1))) \
+                                          << (16 - ANALOG_READ_RESOLUTION))
+
+class AudioSourceADC : public AudioSource
+{
+public:
+
+  bool begin(int rate)
+  {
+    #if defined(ESP32)
+    i2s_config_t config =
+    {
+      .mode = (i2s_mode_t)(I2S_MODE_MASTER | I2S_MODE_RX | I2S_MODE_ADC_BUILT_IN),
+      .sample_rate = (uint32_t)rate,
+      .bits_per_sample = I2S_BITS_PER_SAMPLE_16BIT,
+      .channel_format = I2S_CHANNEL_FMT_ONLY_LEFT,
+      .communication_format = I2S_COMM_FORMAT_I2S_MSB,
+      .intr_alloc_flags = 0,
+      .dma_buf_count = I2S_DMA_BUFFS,
+      .dma_buf_len = blockLen,
+      .use_apll = false
+    };
+
+    if ((i2s_driver_install(I2S_PORT, &config, 0, NULL) != ESP_OK) ||
+        (i2s_set_adc_mode(ADC_UNIT_1, (adc1_channel_t)digitalPinToAnalogChannel(APIN_MICROPHONE)) != ESP_OK) ||
+        (i2s_adc_enable(I2S_PORT) != ESP_OK))
+    {
+      DBGOUT((F("AudioIn: failed to start I2S ADC")));
+      i2s_driver_uninstall(I2S_PORT);
+      return false;
+    }
+    #else
+    pinMode(APIN_MICROPHONE, INPUT);
+    analogReadResolution(ANALOG_READ_RESOLUTION);
+    analogReadAveraging(ANALOG_READ_AVERAGING);
+
+    theSource = this;
+    samplingTimer.begin(Sample_CB, 1000000/rate);
+    #endif
+
+    return true;
+  }
+
+  void end(void)
+  {
+    #if defined(ESP32)
+    i2s_adc_disable(I2S_PORT);
+    i2s_driver_uninstall(I2S_PORT);
+    #else
+    samplingTimer.end();
+    #endif
+  }
+
+  const int16_t *next(void)
+  {
+    #if defined(ESP32)
+    // copies all samples the DMA has so far, returning the oldest block not yet used
+    while (true)
+    {
+      int16_t *psample = fillPtr();
+      size_t bytes = 0;
+
+      i2s_read(I2S_PORT, psample, fillSpace() * sizeof(int16_t), &bytes, 0);
+      if (bytes == 0) break;
+
+      int count = bytes / sizeof(int16_t);
+      for (int i = 0; i < count; ++i)
+        psample[i] = ADC_TO_SAMPLE(psample[i] & 0x0FFF); // upper bits are channel
+
+      filled(count);
+    }
+    return takeReady();
+
+    #else
+    noInterrupts();
+    const int16_t *pblock = takeReady();
+    interrupts();
+    return pblock;
+    #endif
+  }
+
+private:
+
+  #if !defined(ESP32)
+  static IntervalTimer samplingTimer;
+  static AudioSourceADC *theSource;
+
+  static void Sample_CB(void)
+  {
+    *theSource->fillPtr() = ADC_TO_SAMPLE(analogRead(APIN_MICROPHONE));
+    theSource->filled(1);
+  }
+  #endif
+};
+
+#if !defined(ESP32)
+IntervalTimer AudioSourceADC::samplingTimer;
+AudioSourceADC *AudioSourceADC::theSource;
+#endif
+
+#endif // !HOST_BUILD && APIN_MICROPHONE
+
+#if defined(ESP32) && defined(DPIN_I2S_MIC_SD)
+
+#define I2S_MIC_MIN_RATE        8000    // lowest sample rate the microphones support
+#define I2S_READ_SAMPLES        64      // samples read from the DMA buffers at once
+
+class AudioSourceI2S : public AudioSource
+{
+public:
+
+  bool begin(int rate)
+  {
+    decimate = (I2S_MIC_MIN_RATE + rate - 1) / rate;
+    decimateSum = 0;
+    decimateCount = 0;
+
+    i2s_config_t config =
+    {
+      .mode = (i2s_mode_t)(I2S_MODE_MASTER | I2S_MODE_RX),
+      .sample_rate = (uint32_t)(rate * decimate),
+      .bits_per_sample = I2S_BITS_PER_SAMPLE_32BIT,
+      .channel_format = I2S_CHANNEL_FMT_ONLY_LEFT,
+      .communication_format = I2S_COMM_FORMAT_I2S,
+      .intr_alloc_flags = 0,
+      .dma_buf_count = I2S_DMA_BUFFS,
+      .dma_buf_len = I2S_READ_SAMPLES,
+      .use_apll = false
+    };
+
+    i2s_pin_config_t pins =
+    {
+      .bck_io_num = DPIN_I2S_MIC_SCK,
+      .ws_io_num = DPIN_I2S_MIC_WS,
+      .data_out_num = I2S_PIN_NO_CHANGE,
+      .data_in_num = DPIN_I2S_MIC_SD
+    };
+
+    if ((i2s_driver_install(I2S_PORT, &config, 0, NULL) != ESP_OK) ||
+        (i2s_set_pin(I2S_PORT, &pins) != ESP_OK))
+    {
+      DBGOUT((F("AudioIn: failed to start I2S microphone")));
+      i2s_driver_uninstall(I2S_PORT);
+      return false;
+    }
+
+    return true;
+  }
+
+  void end(void)
+  {
+    i2s_driver_uninstall(I2S_PORT);
+  }
+
+  const int16_t *next(void)
+  {
+    int32_t values[I2S_READ_SAMPLES];
+
+    while (true)
+    {
+      size_t bytes = 0;
+      i2s_read(I2S_PORT, values, sizeof(values), &bytes, 0);
+      if (bytes == 0) break;
+
+      int count = bytes / sizeof(int32_t);
+      for (int i = 0; i < count; ++i)
+      {
+        decimateSum += (values[i] >> 16); // 24-bit values are in the upper bits
+        if (++decimateCount >= decimate)
+        {
+          *fillPtr() = (int16_t)(decimateSum / decimate);
+          filled(1);
+          decimateSum = 0;
+          decimateCount = 0;
+        }
+      }
+    }
+
+    return takeReady();
+  }
+
+private:
+  int decimate;                         // number of samples averaged into each one
+  int decimateCount;
+  int32_t decimateSum;
+};
+
+static AudioSourceI2S deviceSource;
+static AudioSource *pSource = &deviceSource;
+
+#elif !HOST_BUILD && defined(APIN_MICROPHONE)
+
+static AudioSourceADC deviceSource;
+static AudioSource *pSource = &deviceSource;
+
+#else
+static AudioSource *pSource = NULL;
+#endif
+
+static bool capturing = false;
+
+void AudioIn_SetSource(AudioSource *psource)
+{
+  AudioIn_End();
+  pSource = psource;
+}
+
+bool AudioIn_Begin(int rate, uint16_t count)
+{
+  AudioIn_End();
+  if (pSource == NULL) return false;
+
+  if (!pSource->alloc(count)) return false;
+  if (!pSource->begin(rate))
+  {
+    pSource->release();
+    return false;
+  }
+
+  DBGOUT((F("AudioIn: rate=%d block=%d"), rate, count));
+  capturing = true;
+  return true;
+}
+
+void AudioIn_End(void)
+{
+  if (capturing)
+  {
+    pSource->end();
+    pSource->release();
+    capturing = false;
+  }
+}
+
+const int16_t *AudioIn_Next(void)
+{
+  if (!capturing) return NULL;
+  return pSource->next();
+}
+
+bool AudioIn_Ended(void)
+{
+  return (!capturing || pSource->ended());
+}
+
+uint16_t AudioIn_Overruns(void)
+{
+  return (capturing ? pSource->overruns : 0);
+}
+
+#endif // FREQ_FFT
@@ -0,0 +1,59 @@
+/*
+Copyright (c) 2021, Greg de Valois
+Software License Agreement (MIT License)
+See license.txt for the terms of this license.
+*/
+// Continuous audio capture into a ring of blocks: one is filled while those before it
+// wait to be used, so no samples are lost while earlier blocks are analyzed, even if
+// that's done less often than blocks are filled. Samples are Q15 values centered on zero.
+
+#if FREQ_FFT
+
+#if !defined(AUDIO_BLOCKS)
+#define AUDIO_BLOCKS            8       // number of blocks in the ring (a power of 2)
+#endif
+
+// Each source of audio fills the blocks (from an interrupt or when asked for the next
+// block), while the blocks themselves and switching between them is done here.
+class AudioSource
+{
+public:
+  AudioSource(void) : overruns(0), blocks(NULL) {}
+
+  virtual bool begin(int rate) = 0;         // starts capture at 'rate' samples/sec
+  virtual void end(void) = 0;
+
+  // Returns the oldest block filled and not yet returned, or NULL if none. It must be used
+  // (or copied) before another block is filled, in case the ring is full by then.
+  virtual const int16_t *next(void) = 0;
+
+  virtual bool ended(void) { return false; } // true once a stream has no more samples
+
+  bool alloc(uint16_t count);               // allocates blocks of 'count' samples
+  void release(void);
+
+  volatile uint16_t overruns;               // number of blocks filled that were never used
+
+protected:
+  int16_t *blocks;                          // all blocks of samples, one after the other
+  uint16_t blockLen;
+  volatile uint16_t fillBlocks;             // number of blocks filled (only changed by filled())
+  volatile uint16_t fillCount;              // samples already in the block being filled
+  uint16_t readBlocks;                      // number of blocks used or dropped (by takeReady())
+
+  int16_t *fillPtr(void) { return blocks + ((fillBlocks % AUDIO_BLOCKS) * blockLen) + fillCount; }
+  uint16_t fillSpace(void) { return blockLen - fillCount; }
+
+  void filled(uint16_t count);              // 'count' samples were added at fillPtr()
+  const int16_t *takeReady(void);           // returns the oldest ready block, if any
+};
+
+extern void AudioIn_SetSource(AudioSource *psource); // replaces source for the device
+
+extern bool AudioIn_Begin(int rate, uint16_t count); // starts capture of 'count' sample blocks
+extern void AudioIn_End(void);
+extern const int16_t *AudioIn_Next(void);   // same as AudioSource::next()
+extern bool AudioIn_Ended(void);            // true if not capturing (any more)
+extern uint16_t AudioIn_Overruns(void);
+
+#endif // FREQ_FFT
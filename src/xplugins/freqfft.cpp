@@ -5,146 +5,289 @@ Copyright (c) 2021, Greg de Valois
 Software License Agreement (MIT License)
 See license.txt for the terms of this license.
 */
+// Short-time FFT: each block of captured samples is a quarter of the FFT, which is run on it
+// and the blocks before (75% overlap), multiplied by a window function so the frequencies
+// don't smear across the spectrum. The magnitudes of the FFT bins are then averaged into
+// bands whose edges are spaced by pitch (mel or log scale), with the weights of each bin
+// in each band calculated when initialized, so only the bins that overlap a band are used.
 
 #include "main.h"
 #include "freqfft.h"
+#include "audioin.h"
 
 #if FREQ_FFT
 
+#define FFT_SIZE                128     // Determines number of samples used by each FFT
+#define FFT_HOP                 (FFT_SIZE/4) // Number of samples gathered before each FFT
+                                        // (16 msecs at 2KHz, for onsets to be detected quickly)
+#define FFT_BLOCKS              (FFT_SIZE/FFT_HOP) // Number of blocks in each FFT
+#define FFT_INPUT_SHIFT         6       // Q15 samples to 10-bit ADC values the decibels are for
+
+#define FFT_WINDOW_HANN         1
+#define FFT_WINDOW_BLACKMAN     2
+#if !defined(FFT_WINDOW)
+#define FFT_WINDOW              FFT_WINDOW_HANN
+#endif
+
+#if !defined(FFT_BANDS_MEL)
+#define FFT_BANDS_MEL           1       // 1 for band edges on the mel scale, 0 for log scale
+#endif
+
+#if FREQ_FFT_CMSIS
 #define ARM_MATH_CM4
-#include <arm_math.h> // TODO: how to do this on ESP32?
+#include <arm_math.h>
+static float samples[FFT_SIZE*2];       // complex values: imaginary parts are zero
+#else
+#include "realfft.h"
+static int32_t fftWork[FFT_SIZE+2];
+static uint32_t fftPower[FFT_SIZE/2];
+#endif
+
+typedef struct
+{
+  uint16_t bin;                         // FFT bin in the band
+  float weight;                         // part of the bin in the band, over band width
+}
+BandWeight;
 
-#define ANALOG_READ_RESOLUTION  10      // Bits of resolution for the ADC
-#define ANALOG_READ_AVERAGING   16      // Number of samples to average with each ADC reading
-#define FFT_SIZE                64      // Determines number of samples gathered before FFT
+static int16_t frameSamples[FFT_SIZE];  // previous and current blocks
+static int frameBlocks;                 // number of those that are contiguous samples
+static uint16_t lastOverruns;           // blocks lost before the previous block
+static uint16_t skipBlocks;             // blocks captured since the last frame (lost or not)
+static uint16_t frameSkipped;           // those for the latest frame
+static int16_t windowSamples[FFT_SIZE]; // those multiplied by the window
+static int16_t *windowVals = NULL;      // Q15 window function values
 
-static IntervalTimer samplingTimer;
-static float samples[FFT_SIZE*2];
-static int sampleCounter = 0;
+static BandWeight *bandWeights = NULL;  // weights for all bands, in band order
+static uint16_t *bandStarts = NULL;     // index into weights for each band (and one more)
+
+static bool capturing = false;
 
 static float magnitudes[FFT_SIZE];
-static float* freqWindow = NULL;
 static int freqCount;
 
 static int minDB, maxDB;
 static int sampleRate;
 
-static void FreqFFT_GetData_CB()
+// Convert a frequency to and from the pitch scale the bands are evenly spaced on
+static float frequencyToPitch(float frequency)
 {
-  int data = analogRead(APIN_MICROPHONE);
-  //DBGOUT((F("FreqFFT: %d) data=%d"), sampleCounter, data));
-
-  samples[sampleCounter++] = (float32_t)data;
-  // Complex FFT functions require a coefficient for the imaginary part of the input.
-  // Since we only have real data, set this coefficient to zero.
-  samples[sampleCounter++] = 0.0;
-
-  // stop after the buffer is filled
-  if (sampleCounter >= FFT_SIZE*2) samplingTimer.end();
+  #if FFT_BANDS_MEL
+  return 2595.0 * log10(1.0 + (frequency / 700.0));
+  #else
+  return log10(frequency);
+  #endif
 }
 
-// Reset sample buffer position and start callback at necessary rate
-static void samplingBegin(void)
+static float pitchToFrequency(float pitch)
 {
-  sampleCounter = 0;
-  samplingTimer.begin(FreqFFT_GetData_CB, 1000000/sampleRate);
+  #if FFT_BANDS_MEL
+  return 700.0 * (pow(10.0, pitch / 2595.0) - 1.0);
+  #else
+  return pow(10.0, pitch);
+  #endif
 }
 
 bool FreqFFT_Init(int rate, uint16_t count)
 {
-  analogReadResolution(ANALOG_READ_RESOLUTION);
-  analogReadAveraging(ANALOG_READ_AVERAGING);
-
   sampleRate = rate;
   freqCount = count;
 
-  freqWindow = (float*)malloc(sizeof(float) * freqCount+1);
-  if (freqWindow == NULL) return false;
+  #if !FREQ_FFT_CMSIS
+  if (!RealFFT_Init(FFT_SIZE)) return false;
+  #endif
 
-  // Set the frequency window values by evenly dividing the
-  // possible frequency spectra across the number of slots
-  float windowSize = (sampleRate / 2.0) / float(freqCount);
+  // each bin is in at least one band, and each band adds at most one more weight
+  int maxweights = (FFT_SIZE/2) + freqCount;
 
-  for (int i = 0; i <= freqCount; ++i)
-    freqWindow[i] = i * windowSize;
+  windowVals = (int16_t*)malloc(FFT_SIZE * sizeof(int16_t));
+  bandWeights = (BandWeight*)malloc(maxweights * sizeof(BandWeight));
+  bandStarts = (uint16_t*)malloc((freqCount+1) * sizeof(uint16_t));
+
+  if ((windowVals == NULL) || (bandWeights == NULL) || (bandStarts == NULL))
+  {
+    FreqFFT_Fini();
+    return false;
+  }
+
+  // the window reduces the magnitudes (by its average value), so the weights make up for that
+  double gain = 0.0;
+  for (int i = 0; i < FFT_SIZE; ++i)
+  {
+    double angle = (2 * 3.14159265358979 * i) / FFT_SIZE;
+    #if (FFT_WINDOW == FFT_WINDOW_BLACKMAN)
+    double value = 0.42 - (0.5 * cos(angle)) + (0.08 * cos(2 * angle));
+    #else
+    double value = 0.5 - (0.5 * cos(angle));
+    #endif
+    windowVals[i] = (int16_t)lround(value * 32767);
+    gain += value;
+  }
+  gain /= FFT_SIZE;
+
+  // bin 'k' spans k-0.5...k+0.5 (in bins): the first one is skipped because it represents
+  // average signal power, so the bands span from bin 1 up to half the sampling rate
+  float binFrequency = float(sampleRate) / float(FFT_SIZE);
+  float lowPitch  = frequencyToPitch(0.5 * binFrequency);
+  float highPitch = frequencyToPitch(((FFT_SIZE/2) - 0.5) * binFrequency);
+  float lowEdge = 0.5;
+  int index = 0;
+
+  for (int i = 0; i < freqCount; ++i)
+  {
+    float pitch = lowPitch + ((highPitch - lowPitch) * (i+1)) / freqCount;
+    float highEdge = pitchToFrequency(pitch) / binFrequency;
+    if (i == freqCount-1) highEdge = (FFT_SIZE/2) - 0.5; // no rounding errors at the end
+
+    bandStarts[i] = index;
+
+    for (int k = (int)(lowEdge + 0.5); (k < FFT_SIZE/2) && ((k - 0.5) < highEdge); ++k)
+    {
+      float lo = ((k - 0.5) > lowEdge)  ? (k - 0.5) : lowEdge;
+      float hi = ((k + 0.5) < highEdge) ? (k + 0.5) : highEdge;
+      if ((hi <= lo) || (index >= maxweights)) continue;
+
+      bandWeights[index].bin = k;
+      bandWeights[index].weight = (hi - lo) / ((highEdge - lowEdge) * gain);
+      ++index;
+    }
+
+    lowEdge = highEdge;
+  }
+  bandStarts[freqCount] = index;
 
+  DBGOUT((F("FreqFFT: bands=%d weights=%d"), freqCount, index));
+
+  memset(frameSamples, 0, sizeof(frameSamples));
+  frameBlocks = 0;
+  lastOverruns = 0;
+  skipBlocks = 0;
+  frameSkipped = 0;
   return true;
 }
 
 void FreqFFT_Fini(void)
 {
-  if (freqWindow != NULL)
+  if (capturing)
   {
-    free(freqWindow);
-    freqWindow = NULL;
+    AudioIn_End();
+    capturing = false;
   }
+
+  if (windowVals != NULL)  free(windowVals);
+  if (bandWeights != NULL) free(bandWeights);
+  if (bandStarts != NULL)  free(bandStarts);
+
+  windowVals = NULL;
+  bandWeights = NULL;
+  bandStarts = NULL;
+
+  #if !FREQ_FFT_CMSIS
+  RealFFT_Fini();
+  #endif
 }
 
 void FreqFFT_Begin(int min, int max)
 {
   minDB = min;
   maxDB = max;
-  samplingBegin();
+
+  // capture continues from then on, so isn't restarted by later calls
+  if (!capturing) capturing = AudioIn_Begin(sampleRate, FFT_HOP);
 }
 
-// Compute the average magnitude of a target frequency window
-static float windowMean(float* magnitudes, int lowBin, int highBin)
+float FreqFFT_FrameRate(void)
 {
-    float value = 0.0;
-
-    // first bin is skipped because it represents average signal power
-    for (int i = 1; i < FFT_SIZE/2; ++i)
-    {
-      if (lowBin <= i) value += magnitudes[i];
-      if (i > highBin) break;
-    }
-
-    return value / (highBin - lowBin + 1);
+  return (float)sampleRate / FFT_HOP;
 }
 
-// Convert a frequency to the appropriate FFT bin it falls within
-static int inline frequencyToBin(float frequency)
+uint16_t FreqFFT_Skipped(void)
 {
-  float binFrequency = float(sampleRate) / float(FFT_SIZE);
-  return int(frequency / binFrequency);
+  return frameSkipped;
 }
 
-void FreqFFT_Next(FreqFFT_SetPos_CB valueCB)
+bool FreqFFT_Next(FreqFFT_SetPos_CB valueCB)
 {
-  // calculate FFT once a full sample is available
-  if (sampleCounter >= FFT_SIZE*2)
+  // calculate FFT once a full block of samples is available, and the blocks before it
+  // are the ones captured just before that: after blocks were lost the FFT restarts
+  // once enough new ones fill it, instead of joining samples from either side of the gap
+  do
   {
-    // run FFT on sample data
-    arm_cfft_radix4_instance_f32 fft_inst;
-    arm_cfft_radix4_init_f32(&fft_inst, FFT_SIZE, 0, 1);
-    arm_cfft_radix4_f32(&fft_inst, samples);
-
-    // calculate magnitude of complex numbers output by the FFT
-    arm_cmplx_mag_f32(samples, magnitudes, FFT_SIZE);
-  
-    // calculate intensity in associated frequency window
-    float intensity;
-    for (int i = 0; i < freqCount; ++i)
+    const int16_t *pblock = AudioIn_Next();
+    if (pblock == NULL) return false;
+
+    uint16_t overruns = AudioIn_Overruns();
+    if (overruns != lastOverruns)
     {
-      intensity = windowMean(magnitudes, 
-                    frequencyToBin(freqWindow[i]),
-                    frequencyToBin(freqWindow[i+1]));
+      DBGOUT((F("FreqFFT: lost %d blocks"), (uint16_t)(overruns - lastOverruns)));
+      skipBlocks += (uint16_t)(overruns - lastOverruns);
+      lastOverruns = overruns;
+      frameBlocks = 0;
+    }
 
-      // convert intensity to decibels
-      intensity = 20.0*log10(intensity);
+    // slide the new block in after the previous ones
+    memmove(frameSamples, frameSamples + FFT_HOP, (FFT_SIZE - FFT_HOP) * sizeof(int16_t));
+    memcpy(frameSamples + (FFT_SIZE - FFT_HOP), pblock, FFT_HOP * sizeof(int16_t));
+    if (frameBlocks < FFT_BLOCKS) ++frameBlocks;
+    if (frameBlocks < FFT_BLOCKS) ++skipBlocks;
+  }
+  while (frameBlocks < FFT_BLOCKS);
 
-      // scale the intensity and clamp between 0.05 and 1.0
-      intensity -= minDB;
-      intensity = intensity < 0.0 ? 0.0 : intensity;
-      intensity /= (maxDB - minDB);
-      intensity = intensity > 1.0  ? 1.0  : intensity;
-      intensity = intensity < 0.05 ? 0.05 : intensity;
+  frameSkipped = skipBlocks;
+  skipBlocks = 0;
 
-      (*valueCB)(i, intensity);
-    }
+  // apply the window to all of them
+  for (int i = 0; i < FFT_SIZE; ++i)
+    windowSamples[i] = ((int32_t)frameSamples[i] * windowVals[i]) >> 15;
 
-    samplingBegin();
+  #if FREQ_FFT_CMSIS
+  // Complex FFT functions require a coefficient for the imaginary part of the input.
+  // Since we only have real data, set this coefficient to zero.
+  for (int i = 0; i < FFT_SIZE; ++i)
+  {
+    samples[2*i] = (float32_t)windowSamples[i] / (1 << FFT_INPUT_SHIFT);
+    samples[2*i+1] = 0.0;
+  }
+
+  // run FFT on sample data
+  arm_cfft_radix4_instance_f32 fft_inst;
+  arm_cfft_radix4_init_f32(&fft_inst, FFT_SIZE, 0, 1);
+  arm_cfft_radix4_f32(&fft_inst, samples);
+
+  // calculate magnitude of complex numbers output by the FFT
+  arm_cmplx_mag_f32(samples, magnitudes, FFT_SIZE);
+  #else
+  RealFFT_Power(windowSamples, fftWork, fftPower);
+
+  // results are scaled down by the FFT size, and samples up from the ADC values:
+  // undo both so the magnitudes (and the decibel range) are the same as above
+  for (int i = 0; i < FFT_SIZE/2; ++i)
+    magnitudes[i] = sqrtf((float)fftPower[i]) * ((float)FFT_SIZE / (1 << FFT_INPUT_SHIFT));
+  #endif
+
+  // calculate intensity in associated frequency band
+  BandWeight *pweight = bandWeights;
+  float intensity;
+  for (int i = 0; i < freqCount; ++i)
+  {
+    intensity = 0.0;
+    for (int j = bandStarts[i]; j < bandStarts[i+1]; ++j, ++pweight)
+      intensity += magnitudes[pweight->bin] * pweight->weight;
+
+    // convert intensity to decibels
+    intensity = 20.0*log10(intensity);
+
+    // scale the intensity and clamp between 0.05 and 1.0
+    intensity -= minDB;
+    intensity = intensity < 0.0 ? 0.0 : intensity;
+    intensity /= (maxDB - minDB);
+    intensity = intensity > 1.0  ? 1.0  : intensity;
+    intensity = intensity < 0.05 ? 0.05 : intensity;
+
+    (*valueCB)(i, intensity);
   }
+
+  return true;
 }
 
 #endif // FREQ_FFT
@@ -11,6 +11,9 @@ typedef void (*FreqFFT_SetPos_CB)(int pos, float value);
 extern bool FreqFFT_Init(int rate, uint16_t count);
 extern void FreqFFT_Fini(void);
 extern void FreqFFT_Begin(int min, int max);
-extern void FreqFFT_Next(FreqFFT_SetPos_CB valueCB);
+extern bool FreqFFT_Next(FreqFFT_SetPos_CB valueCB); // false if no new frame yet (call until false)
+extern float FreqFFT_FrameRate(void); // number of times per second Next() has new values
+extern uint16_t FreqFFT_Skipped(void); // blocks captured since the frame before the latest one
+                                       // that weren't analyzed into a frame (lost or restarting)
 
 #endif // FREQ_FFT
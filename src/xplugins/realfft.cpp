@@ -0,0 +1,136 @@
+// PixelNutApp Fixed-Point Real FFT Routines
+//========================================================================================
+/*
+Copyright (c) 2021, Greg de Valois
+Software License Agreement (MIT License)
+See license.txt for the terms of this license.
+*/
+// The 'size' real samples x[] are packed into size/2 complex values z[k] = x[2k] + i*x[2k+1],
+// so a complex FFT of half the size (instead of zero filling the imaginary parts) gives Z[].
+// The spectrum of the real samples is then split out of that with:
+//
+//    X[k] = (Z[k] + conj(Z[h-k]))/2 - i*W^k * (Z[k] - conj(Z[h-k]))/2,  W = e^(-2*pi*i/size)
+//
+// Each butterfly stage halves its results, so the magnitudes never grow and all products
+// of values with the Q15 twiddle factors fit into 32 bits.
+
+#include "main.h"
+#include "realfft.h"
+
+#if FREQ_FFT
+
+static int16_t *twiddleCos = NULL;  // cos/sin of 2*pi*k/size for k=0...size/2-1
+static int16_t *twiddleSin = NULL;
+static uint16_t fftSize;
+
+#define Q15_MULT(a,w) (((a) * (int32_t)(w)) >> 15)
+
+bool RealFFT_Init(uint16_t size)
+{
+  RealFFT_Fini();
+  if ((size < 4) || (size > REALFFT_MAX_SIZE) || (size & (size-1))) return false;
+
+  twiddleCos = (int16_t*)malloc((size/2) * sizeof(int16_t));
+  twiddleSin = (int16_t*)malloc((size/2) * sizeof(int16_t));
+  if ((twiddleCos == NULL) || (twiddleSin == NULL))
+  {
+    RealFFT_Fini();
+    return false;
+  }
+
+  fftSize = size;
+
+  for (int k = 0; k < size/2; ++k)
+  {
+    double angle = (2 * 3.14159265358979 * k) / size;
+    twiddleCos[k] = (int16_t)lround(cos(angle) * 32767);
+    twiddleSin[k] = (int16_t)lround(sin(angle) * 32767);
+  }
+
+  return true;
+}
+
+void RealFFT_Fini(void)
+{
+  if (twiddleCos != NULL) free(twiddleCos);
+  if (twiddleSin != NULL) free(twiddleSin);
+  twiddleCos = twiddleSin = NULL;
+}
+
+// in-place radix-2 decimation in time FFT of 'count' (a power of 2) complex values,
+// stored as (re,im) pairs, with each stage scaled by 1/2
+static void ComplexFFT(int32_t *data, int count)
+{
+  // reorder into bit reversed order
+  for (int i = 1, j = 0; i < count; ++i)
+  {
+    int bit = count >> 1;
+    for (; j & bit; bit >>= 1) j ^= bit;
+    j |= bit;
+
+    if (i < j)
+    {
+      int32_t t;
+      t = data[2*i];   data[2*i]   = data[2*j];   data[2*j]   = t;
+      t = data[2*i+1]; data[2*i+1] = data[2*j+1]; data[2*j+1] = t;
+    }
+  }
+
+  // twiddle factors for this FFT are every 'tstep' one of the table
+  int tstep = fftSize / 2;
+
+  for (int span = 1; span < count; span <<= 1)
+  {
+    for (int k = 0; k < span; ++k)
+    {
+      int32_t wr =  twiddleCos[k * tstep];
+      int32_t wi = -twiddleSin[k * tstep];
+
+      for (int i = k; i < count; i += (span << 1))
+      {
+        int32_t *pa = data + (2 * i);
+        int32_t *pb = pa + (2 * span);
+
+        int32_t tr = Q15_MULT(pb[0], wr) - Q15_MULT(pb[1], wi);
+        int32_t ti = Q15_MULT(pb[0], wi) + Q15_MULT(pb[1], wr);
+
+        pb[0] = (pa[0] - tr) >> 1;
+        pb[1] = (pa[1] - ti) >> 1;
+        pa[0] = (pa[0] + tr) >> 1;
+        pa[1] = (pa[1] + ti) >> 1;
+      }
+    }
+
+    tstep >>= 1;
+  }
+}
+
+void RealFFT_Power(const int16_t *samples, int32_t *work, uint32_t *power)
+{
+  int half = fftSize / 2;
+
+  for (int i = 0; i < fftSize; ++i) work[i] = samples[i];
+  ComplexFFT(work, half);
+
+  work[2*half] = work[0]; // Z[half] is the same as Z[0]
+  work[2*half+1] = work[1];
+
+  for (int k = 0; k < half; ++k)
+  {
+    int32_t ar = work[2*k],          ai = work[2*k+1];
+    int32_t br = work[2*(half-k)],   bi = -work[2*(half-k)+1]; // conj(Z[half-k])
+
+    int32_t er = (ar + br) >> 1,     ei = (ai + bi) >> 1;     // even samples
+    int32_t dr = (ar - br) >> 1,     di = (ai - bi) >> 1;     // odd: -i*d
+
+    int32_t orr = di, oi = -dr;
+    int32_t wr = twiddleCos[k], wi = -twiddleSin[k];
+
+    int32_t xr = (er + Q15_MULT(orr, wr) - Q15_MULT(oi, wi)) >> 1;
+    int32_t xi = (ei + Q15_MULT(orr, wi) + Q15_MULT(oi, wr)) >> 1;
+
+    power[k] = (uint32_t)(xr * xr) + (uint32_t)(xi * xi);
+  }
+}
+
+#endif // FREQ_FFT
@@ -0,0 +1,22 @@
+/*
+Copyright (c) 2021, Greg de Valois
+Software License Agreement (MIT License)
+See license.txt for the terms of this license.
+*/
+// Fixed-point FFT of real samples, for any processor: 'size' samples (a power of 2 from
+// 4 up to REALFFT_MAX_SIZE) are transformed as a complex FFT of half that size, whose
+// output is then split into the spectrum of the real samples. Samples are Q15 values,
+// and the results are scaled by 1/size (so are the same range as the samples).
+
+#if FREQ_FFT
+
+#define REALFFT_MAX_SIZE        1024
+
+extern bool RealFFT_Init(uint16_t size);  // calculates twiddle factors, false if failed
+extern void RealFFT_Fini(void);
+
+// Calculates the power (re^2 + im^2) of bins 0...size/2-1 of the FFT of 'samples'
+// into 'power', using 'work' (of size+2 values) for the intermediate results.
+extern void RealFFT_Power(const int16_t *samples, int32_t *work, uint32_t *power);
+
+#endif // FREQ_FFT